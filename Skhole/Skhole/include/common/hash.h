@@ -0,0 +1,49 @@
+#pragma once
+
+#include <include.h>
+
+namespace Skhole {
+
+	constexpr uint64_t SKHOLE_HASH_SEED = 0xcbf29ce484222325ull;
+
+	inline uint64_t HashMix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	inline uint64_t HashCombine(uint64_t seed, uint64_t value) {
+		return HashMix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+	}
+
+	// 64bit hash of a byte range, processes 8 bytes per step
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = SKHOLE_HASH_SEED) {
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+		size_t numWord = size / 8;
+		for (size_t i = 0; i < numWord; i++) {
+			uint64_t w;
+			memcpy(&w, p + i * 8, 8);
+			h ^= w * 0x87c37b91114253d5ull;
+			h = (h << 31) | (h >> 33);
+			h *= 0x4cf5ad432745937full;
+		}
+
+		uint64_t tail = 0;
+		size_t rest = size - numWord * 8;
+		if (rest > 0) {
+			memcpy(&tail, p + numWord * 8, rest);
+			h ^= tail * 0x87c37b91114253d5ull;
+		}
+
+		return HashMix(h);
+	}
+
+	inline uint64_t HashString(const std::string& str, uint64_t seed = SKHOLE_HASH_SEED) {
+		return HashBytes(str.data(), str.size(), seed);
+	}
+}
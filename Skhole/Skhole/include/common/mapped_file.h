@@ -0,0 +1,109 @@
+#pragma once
+
+#include <include.h>
+#include <common/log.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Skhole {
+
+	// Read-only memory mapped view of a whole file
+	class MappedFile {
+	public:
+		MappedFile() {};
+		~MappedFile() { Close(); };
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& path) {
+			Close();
+
+#ifdef _WIN32
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE) {
+				SKHOLE_LOG("Failed to open file : " + path);
+				return false;
+			}
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+				SKHOLE_LOG("Empty file : " + path);
+				Close();
+				return false;
+			}
+			m_size = static_cast<size_t>(fileSize.QuadPart);
+
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping == nullptr) {
+				SKHOLE_ERROR("Failed to map file : " + path);
+				Close();
+				return false;
+			}
+
+			m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+			m_fd = open(path.c_str(), O_RDONLY);
+			if (m_fd < 0) {
+				SKHOLE_LOG("Failed to open file : " + path);
+				return false;
+			}
+
+			struct stat st;
+			if (fstat(m_fd, &st) != 0 || st.st_size == 0) {
+				SKHOLE_LOG("Empty file : " + path);
+				Close();
+				return false;
+			}
+			m_size = static_cast<size_t>(st.st_size);
+
+			void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+			m_data = (view == MAP_FAILED) ? nullptr : static_cast<const uint8_t*>(view);
+#endif
+
+			if (m_data == nullptr) {
+				SKHOLE_ERROR("Failed to map file : " + path);
+				Close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void Close() {
+#ifdef _WIN32
+			if (m_data) UnmapViewOfFile(m_data);
+			if (m_mapping) CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+			m_mapping = nullptr;
+			m_file = INVALID_HANDLE_VALUE;
+#else
+			if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+			if (m_fd >= 0) close(m_fd);
+			m_fd = -1;
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		bool IsOpen() const { return m_data != nullptr; }
+		const uint8_t* GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+
+#ifdef _WIN32
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#else
+		int m_fd = -1;
+#endif
+	};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <include.h>
+#include <thread>
+#include <atomic>
+
+namespace Skhole {
+
+	inline uint32_t GetWorkerCount() {
+		static const uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+		return count;
+	}
+
+	// Number of chunks ParallelForChunk will use for the same arguments
+	inline size_t GetParallelChunkCount(size_t count, size_t minChunkSize) {
+		if (count == 0) return 0;
+		size_t numChunk = std::min<size_t>(GetWorkerCount(), (count + minChunkSize - 1) / std::max<size_t>(minChunkSize, 1));
+		return std::max<size_t>(numChunk, 1);
+	}
+
+	// Split [0, count) into at most GetWorkerCount() contiguous chunks.
+	// func(chunkIndex, begin, end) is called once per chunk.
+	// Chunks are never smaller than minChunkSize, so small ranges run on the calling thread.
+	template <typename Func>
+	inline void ParallelForChunk(size_t count, size_t minChunkSize, Func&& func) {
+		if (count == 0) return;
+
+		size_t numChunk = GetParallelChunkCount(count, minChunkSize);
+		if (numChunk == 1) {
+			func(size_t(0), size_t(0), count);
+			return;
+		}
+
+		size_t chunkSize = (count + numChunk - 1) / numChunk;
+
+		std::vector<std::thread> threads;
+		threads.reserve(numChunk - 1);
+		for (size_t i = 1; i < numChunk; i++) {
+			size_t begin = std::min(i * chunkSize, count);
+			size_t end = std::min(begin + chunkSize, count);
+			threads.emplace_back([&func, i, begin, end]() { func(i, begin, end); });
+		}
+
+		func(size_t(0), size_t(0), std::min(chunkSize, count));
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	// func(index) for every index in [0, count)
+	template <typename Func>
+	inline void ParallelFor(size_t count, size_t minChunkSize, Func&& func) {
+		ParallelForChunk(count, minChunkSize, [&func](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				func(i);
+			}
+			});
+	}
+
+	// Hands out indices one by one to the workers, for items with very different cost
+	template <typename Func>
+	inline void ParallelForDynamic(size_t count, Func&& func) {
+		if (count == 0) return;
+
+		std::atomic<size_t> next = 0;
+		size_t numWorker = std::min<size_t>(GetWorkerCount(), count);
+
+		auto worker = [&]() {
+			for (size_t i = next++; i < count; i = next++) {
+				func(i);
+			}
+			};
+
+		std::vector<std::thread> threads;
+		threads.reserve(numWorker - 1);
+		for (size_t i = 1; i < numWorker; i++) {
+			threads.emplace_back(worker);
+		}
+		worker();
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+}
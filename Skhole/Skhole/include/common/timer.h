@@ -6,6 +6,7 @@ namespace Skhole
 {
 	class Timer 
 	{
+	public:
 		Timer(){};
 		~Timer(){};
 
@@ -7,6 +7,7 @@
 #include <scene/material/material.h>
 #include <scene/object/instance.h>
 #include <scene/object/cameraObject.h>
+#include <scene/object/skin.h>
 namespace Skhole {
 
 	// For GLTF Binary Data
@@ -156,7 +157,8 @@ namespace Skhole {
 		std::vector<ShrPtr<Object>>& inObjects,
 		std::vector<ShrPtr<Geometry>>& inGeometies,
 		std::vector<ShrPtr<BasicMaterial>>& inBasicMaterials,
-		std::vector<ShrPtr<Texture>>& inTextures
+		std::vector<ShrPtr<Texture>>& inTextures,
+		std::vector<ShrPtr<Skin>>& inSkins
 	);
 
 	bool OutputPNG(
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <include.h>
+#include <common/log.h>
+#include <common/hash.h>
+#include <common/filepath.h>
+#include <common/mapped_file.h>
+#include <scene/scene.h>
+#include <scene/geometry_container.h>
+#include <scene/scene_exporter.h>
+#include <nlohmann/json.hpp>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Import Cache
+	//-----------------------------------------------------
+	// Processed result of Loader::LoadFile, stored in one file.
+	// [Header][Objects (.skobj text)][Materials (json)][Geometry Container]
+	// The cache key is a hash of the source file, the files it references, the load options and
+	// SKHOLE_LOADER_VERSION. Bump SKHOLE_LOADER_VERSION when a loader changes its output.
+
+	constexpr uint32_t SKHOLE_IMPORT_CACHE_MAGIC = 0x48434B53; // "SKCH"
+	constexpr uint32_t SKHOLE_IMPORT_CACHE_VERSION = 2;
+	constexpr uint32_t SKHOLE_LOADER_VERSION = 5;
+
+	inline const std::string& GetImportCacheDirectory() {
+		static const std::string dir = "./cache/";
+		return dir;
+	}
+
+	struct ImportCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t loaderVersion;
+		uint32_t reserved;
+		uint64_t key;
+
+		uint64_t objectOffset;
+		uint64_t objectSize;
+		uint64_t materialOffset;
+		uint64_t materialSize;
+		uint64_t geometryOffset;
+		uint64_t geometrySize;
+	};
+
+	static_assert(sizeof(ImportCacheHeader) == 72, "ImportCacheHeader layout changed");
+
+	// Files loaded together with the source (.bin for gltf, .mtl for obj)
+	inline void CollectImportDependencies(const std::string& path, const std::string& extension, const uint8_t* data, size_t size, std::vector<std::string>& dependencies)
+	{
+		std::string dir = std::filesystem::path(path).parent_path().string();
+		if (!dir.empty()) dir += "/";
+
+		if (extension == "gltf") {
+			nlohmann::json gltfJs = nlohmann::json::parse(data, data + size, nullptr, false);
+			if (gltfJs.is_discarded() || !gltfJs.contains("buffers")) return;
+
+			for (auto& buffer : gltfJs["buffers"]) {
+				if (!buffer.contains("uri")) continue;
+				std::string uri = buffer["uri"];
+				if (uri.rfind("data:", 0) == 0) continue;
+				dependencies.push_back(dir + uri);
+			}
+		}
+		else if (extension == "obj") {
+			const char* text = reinterpret_cast<const char*>(data);
+			size_t pos = 0;
+			while (pos < size) {
+				size_t end = pos;
+				while (end < size && text[end] != '\n') end++;
+
+				if (end - pos > 7 && strncmp(text + pos, "mtllib ", 7) == 0) {
+					std::string name(text + pos + 7, end - pos - 7);
+					while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) name.pop_back();
+					dependencies.push_back(dir + name);
+				}
+
+				pos = end + 1;
+			}
+		}
+	}
+
+	inline bool ComputeImportCacheKey(const std::string& path, uint64_t optionHash, uint64_t& key)
+	{
+		std::string extension;
+		if (!GetFileExtension(path, extension)) return false;
+
+		MappedFile source;
+		if (!source.Open(path)) return false;
+
+		key = HashCombine(SKHOLE_LOADER_VERSION, HashString(extension));
+		key = HashCombine(key, optionHash);
+		key = HashCombine(key, HashBytes(source.GetData(), source.GetSize()));
+
+		std::vector<std::string> dependencies;
+		CollectImportDependencies(path, extension, source.GetData(), source.GetSize(), dependencies);
+
+		for (auto& dependency : dependencies) {
+			MappedFile file;
+			if (file.Open(dependency)) {
+				key = HashCombine(key, HashBytes(file.GetData(), file.GetSize()));
+			}
+			else {
+				key = HashCombine(key, HashString(dependency));
+			}
+		}
+
+		return true;
+	}
+
+	inline std::string GetImportCachePath(uint64_t key)
+	{
+		std::ostringstream os;
+		os << GetImportCacheDirectory() << std::hex << std::setw(16) << std::setfill('0') << key << ".skcache";
+		return os.str();
+	}
+
+	inline bool LoadImportCache(uint64_t key, ShrPtr<Scene>& scene)
+	{
+		std::string cachePath = GetImportCachePath(key);
+		if (!std::filesystem::exists(cachePath)) return false;
+
+		MappedFile file;
+		if (!file.Open(cachePath)) return false;
+
+		const uint8_t* data = file.GetData();
+		size_t size = file.GetSize();
+
+		if (size < sizeof(ImportCacheHeader)) return false;
+
+		ImportCacheHeader header;
+		memcpy(&header, data, sizeof(header));
+
+		if (header.magic != SKHOLE_IMPORT_CACHE_MAGIC ||
+			header.version != SKHOLE_IMPORT_CACHE_VERSION ||
+			header.loaderVersion != SKHOLE_LOADER_VERSION ||
+			header.key != key) {
+			SKHOLE_WARN("Import cache is outdated : " + cachePath);
+			return false;
+		}
+
+		auto inRange = [size](uint64_t offset, uint64_t sectionSize) {
+			return offset <= size && sectionSize <= size - offset;
+			};
+		if (!inRange(header.objectOffset, header.objectSize) ||
+			!inRange(header.materialOffset, header.materialSize) ||
+			!inRange(header.geometryOffset, header.geometrySize)) {
+			SKHOLE_WARN("Import cache is broken : " + cachePath);
+			return false;
+		}
+
+		// Geometry
+		if (!ReadGeometryContainer(data + header.geometryOffset, header.geometrySize, scene->m_geometies)) {
+			return false;
+		}
+
+		// Objects
+		std::istringstream objectStream(std::string(reinterpret_cast<const char*>(data + header.objectOffset), header.objectSize));
+		if (!ReadObjects(objectStream, scene->m_objects)) {
+			SKHOLE_WARN("Import cache is broken, load the source file : " + cachePath);
+			return false;
+		}
+
+		// Materials
+		const char* matBegin = reinterpret_cast<const char*>(data + header.materialOffset);
+		nlohmann::json matJs = nlohmann::json::parse(matBegin, matBegin + header.materialSize, nullptr, false);
+		if (matJs.is_discarded()) {
+			return false;
+		}
+		ImportMaterials(matJs, scene->m_basicMaterials, scene->m_materials);
+
+		SKHOLE_LOG("Load Import Cache : " + cachePath);
+		return true;
+	}
+
+	inline bool SaveImportCache(uint64_t key, const ShrPtr<Scene>& scene)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(GetImportCacheDirectory(), ec);
+
+		// Objects
+		std::ostringstream objectStream;
+		objectStream << std::setprecision(std::numeric_limits<float>::max_digits10);
+		WriteObjects(objectStream, scene->m_objects);
+		std::string objectText = objectStream.str();
+
+		// Materials
+		nlohmann::json matJs;
+		ExportMaterials(scene->m_basicMaterials, scene->m_materials, matJs);
+		std::string materialText = matJs.dump();
+
+		// Geometry
+		std::ostringstream geometryStream(std::ios::binary);
+		if (!WriteGeometryContainer(geometryStream, scene->m_geometies)) {
+			return false;
+		}
+		std::string geometryData = geometryStream.str();
+
+		ImportCacheHeader header{};
+		header.magic = SKHOLE_IMPORT_CACHE_MAGIC;
+		header.version = SKHOLE_IMPORT_CACHE_VERSION;
+		header.loaderVersion = SKHOLE_LOADER_VERSION;
+		header.key = key;
+		header.objectOffset = sizeof(ImportCacheHeader);
+		header.objectSize = objectText.size();
+		header.materialOffset = header.objectOffset + header.objectSize;
+		header.materialSize = materialText.size();
+		header.geometryOffset = AlignContainerOffset(header.materialOffset + header.materialSize);
+		header.geometrySize = geometryData.size();
+
+		// Write to a temporary file first so a broken cache is never left behind
+		std::string cachePath = GetImportCachePath(key);
+		std::string tmpPath = cachePath + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary);
+			if (!file.is_open()) {
+				SKHOLE_WARN("Failed to open file : " + tmpPath);
+				return false;
+			}
+
+			static const char zero[SKGEOM_BLOB_ALIGNMENT] = {};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(objectText.data(), objectText.size());
+			file.write(materialText.data(), materialText.size());
+			file.write(zero, header.geometryOffset - (header.materialOffset + header.materialSize));
+			file.write(geometryData.data(), geometryData.size());
+
+			if (!file.good()) {
+				SKHOLE_WARN("Failed to write import cache : " + tmpPath);
+				file.close();
+				std::filesystem::remove(tmpPath, ec);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(tmpPath, cachePath, ec);
+		if (ec) {
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+
+		SKHOLE_LOG("Save Import Cache : " + cachePath);
+		return true;
+	}
+}
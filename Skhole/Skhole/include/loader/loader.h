@@ -6,6 +6,8 @@
 #include <loader/obj_loader.h>
 #include <loader/gltf_loader.h>
 #include <scene/scene_exporter.h>
+#include <loader/import_cache.h>
+#include <scene/geometry_dedup.h>
 
 namespace Skhole {
 
@@ -14,7 +16,12 @@ namespace Skhole {
 		Loader() {};
 		~Loader() {};
 
-		static ShrPtr<Scene> LoadFile(const std::string& path) {
+		struct LoadOption {
+			ObjLoadOption obj;
+			bool deduplicateGeometry = true;
+		};
+
+		static ShrPtr<Scene> LoadFile(const std::string& path, const LoadOption& option = LoadOption()) {
 			std::string extension;
 			if (!GetFileExtension(path, extension)) {
 				SKHOLE_ERROR("Invalid File Path");
@@ -22,27 +29,51 @@ namespace Skhole {
 
 			ShrPtr<Scene> loadScene = MakeShr<Scene>();
 
-			if (extension == "obj") {
-				LoadObjFile(
-					path,
-					loadScene->m_objects,
-					loadScene->m_geometies,
-					loadScene->m_basicMaterials,
-					loadScene->m_textures
-				);
+			// Import Cache
+			uint64_t cacheKey = 0;
+			uint64_t optionHash = (extension == "obj") ? option.obj.Hash() : 0;
+			optionHash = HashCombine(optionHash, option.deduplicateGeometry ? 1 : 0);
+			bool useCache = ComputeImportCacheKey(path, optionHash, cacheKey);
+			bool loadedFromCache = useCache && LoadImportCache(cacheKey, loadScene);
 
-			}
-			else if (extension == "glb" || extension == "gltf") {
-				LoadGLTFFile(
-					path,
-					loadScene->m_objects,
-					loadScene->m_geometies,
-					loadScene->m_basicMaterials,
-					loadScene->m_textures
-				);
-			}
-			else {
-				SKHOLE_UNIMPL();
+			if (!loadedFromCache) {
+				loadScene = MakeShr<Scene>();
+
+				bool loaded = false;
+				if (extension == "obj") {
+					loaded = LoadObjFile(
+						path,
+						loadScene->m_objects,
+						loadScene->m_geometies,
+						loadScene->m_basicMaterials,
+						loadScene->m_textures,
+						option.obj
+					);
+
+				}
+				else if (extension == "glb" || extension == "gltf") {
+					loaded = LoadGLTFFile(
+						path,
+						loadScene->m_objects,
+						loadScene->m_geometies,
+						loadScene->m_basicMaterials,
+						loadScene->m_textures,
+						loadScene->m_skins
+					);
+				}
+				else {
+					SKHOLE_UNIMPL();
+				}
+
+				// A failed load must not be cached, or the error would not show up again
+				if (!loaded) {
+					SKHOLE_ERROR("Failed to load " << path << ", the import cache is not written");
+					useCache = false;
+				}
+
+				if (option.deduplicateGeometry) {
+					DeduplicateGeometries(*loadScene);
+				}
 			}
 
 			// Camera Setting
@@ -55,8 +86,21 @@ namespace Skhole {
 			}
 
 			// Connect Prim Id
+			std::vector<ShrPtr<Geometry>> connectTargets;
 			for (auto& geometry : loadScene->m_geometies) {
-				CreateConnectPrimId(geometry);
+				if (!geometry->useConnectIndex) connectTargets.push_back(geometry);
+			}
+			if (connectTargets.size() > 0) {
+				CreateConnectPrimIds(connectTargets);
+			}
+
+			// Skins are not stored in the import cache
+			bool haveSkin = std::any_of(loadScene->m_geometies.begin(), loadScene->m_geometies.end(), [](const ShrPtr<Geometry>& geometry) {
+				return geometry->skinIndex.has_value();
+				});
+
+			if (useCache && !loadedFromCache && !haveSkin) {
+				SaveImportCache(cacheKey, loadScene);
 			}
 
 			return loadScene;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <include.h>
+#include <common/hash.h>
 
 #include <scene/object/object.h>
 #include <scene/object/geometry.h>
@@ -12,11 +13,25 @@
 
 
 namespace Skhole {
+	struct ObjLoadOption {
+		// Merge identical face corners into one indexed vertex
+		bool weldVertices = true;
+
+		// Multi-threaded parser instead of tinyobj::LoadObj
+		bool parallelParse = true;
+
+		uint64_t Hash() const {
+			uint64_t hash = HashCombine(SKHOLE_HASH_SEED, weldVertices ? 1 : 0);
+			return HashCombine(hash, parallelParse ? 1 : 0);
+		}
+	};
+
 	bool LoadObjFile(
 		const std::string& filename,
 		std::vector<ShrPtr<Object>>& inObjects,
 		std::vector<ShrPtr<Geometry>>& inGeometies,
 		std::vector<ShrPtr<BasicMaterial>>& inBasicMaterials,
-		std::vector<ShrPtr<Texture>>& inTextures
+		std::vector<ShrPtr<Texture>>& inTextures,
+		const ObjLoadOption& option = ObjLoadOption()
 	);
 }
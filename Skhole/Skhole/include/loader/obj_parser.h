@@ -0,0 +1,19 @@
+#pragma once
+
+#include <include.h>
+#include <tiny_obj_loader.h>
+
+namespace Skhole {
+
+	// Multi-threaded OBJ parser.
+	// The file is mapped and split into line aligned chunks that are parsed in parallel,
+	// the result is written to the same structures as tinyobj::LoadObj (faces are fan triangulated).
+	bool ParseObjFile(
+		const std::string& filename,
+		tinyobj::attrib_t& attrib,
+		std::vector<tinyobj::shape_t>& shapes,
+		std::vector<tinyobj::material_t>& materials,
+		std::string& warn,
+		std::string& err
+	);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <include.h>
+#include <common/hash.h>
+#include <scene/object/geometry.h>
+
+namespace Skhole {
+
+	// Merge bitwise identical vertices.
+	// corners : one vertex per face corner
+	// outIndices[i] is the welded vertex of corners[i]
+	inline void WeldVertices(const std::vector<VertexData>& corners, std::vector<VertexData>& outVertices, std::vector<uint32_t>& outIndices)
+	{
+		const size_t numCorner = corners.size();
+
+		outVertices.clear();
+		outVertices.reserve(numCorner);
+		outIndices.resize(numCorner);
+
+		// Open addressing table of welded vertex indices
+		size_t tableSize = 16;
+		while (tableSize < numCorner * 2) tableSize <<= 1;
+		const size_t tableMask = tableSize - 1;
+		std::vector<uint32_t> table(tableSize, uint32_t(-1));
+
+		for (size_t i = 0; i < numCorner; i++) {
+			const VertexData& vertex = corners[i];
+			size_t slot = HashBytes(&vertex, sizeof(VertexData)) & tableMask;
+
+			while (true) {
+				uint32_t index = table[slot];
+				if (index == uint32_t(-1)) {
+					index = static_cast<uint32_t>(outVertices.size());
+					table[slot] = index;
+					outVertices.push_back(vertex);
+					outIndices[i] = index;
+					break;
+				}
+				if (memcmp(&outVertices[index], &vertex, sizeof(VertexData)) == 0) {
+					outIndices[i] = index;
+					break;
+				}
+				slot = (slot + 1) & tableMask;
+			}
+		}
+
+		outVertices.shrink_to_fit();
+	}
+}
@@ -42,7 +42,7 @@ namespace Skhole {
 		vk::UniquePipelineLayout pipelineLayout;
 
 		UniformObject uniformObject;
-		Buffer uniformBuffer;
+		FrameRingBuffer uniformBuffer;
 
 		uint32_t width, height;
 
@@ -15,6 +15,7 @@ namespace Skhole {
 			std::vector<VkHelper::BindingLayoutElement> binding;
 
 			uint32_t width, height;
+			uint32_t numFrame = 1;
 		};
 
 	public:
@@ -23,8 +24,10 @@ namespace Skhole {
 
 		void Init(const LayerDesc& desc);
 		void Resize(uint32_t width, uint32_t height);
+		void SetFrame(uint32_t frameIndex);
 		void StartBinding();
 		void SetUniformBuffer(const vk::Buffer& buffer, size_t size, uint32_t bindingIndex, vk::Device device);
+		void SetDynamicUniformBuffer(const vk::Buffer& buffer, size_t size, uint32_t bindingIndex, uint32_t offset, vk::Device device);
 		void SetImage(const vk::ImageView& image, uint32_t index, vk::Device device);
 		void EndBinding(vk::Device device);
 		void Execute(vk::CommandBuffer command, uint32_t dispatchW, uint32_t dispatchH);
@@ -35,5 +38,6 @@ namespace Skhole {
 		vk::UniqueShaderModule csModule;
 		vk::UniquePipelineLayout pipelineLayout;
 		VkHelper::BindingManager bindingManager;
+		std::vector<uint32_t> dynamicOffsets;
 	};
 }
@@ -25,12 +25,16 @@ namespace Skhole {
 			vk::CommandPool commandPool;
 
 			uint32_t width, height;
+
+			// Frames in flight, descriptors and uniforms are kept per frame
+			uint32_t numFrame = 1;
 		};
 
 		struct ExecuteDesc {
 			vk::Device device;
 			vk::ImageView inputImage;
 			vk::ImageView outputImage;
+			uint32_t frameIndex = 0;
 
 			PostProcessParameter param;
 		};
@@ -1,10 +1,16 @@
 #pragma once
 #include <include.h>
 #include <scene/scene.h>
+#include <scene/object/vertex_format.h>
+#include <common/parallel.h>
+#include <common/timer.h>
 #include <vulkan_helpler/vk_buffer.h>
 #include <vulkan_helpler/vk_hepler.h>
+#include <vulkan_helpler/vk_upload.h>
 #include <vulkan_helpler/vkutils.hpp>
 
+#include <unordered_map>
+
 namespace Skhole {
 	class SceneBufferaManager {
 	public:
@@ -14,11 +20,35 @@ namespace Skhole {
 		struct GeometryData {
 			uint32_t vertexOffset;
 			uint32_t indexOffset;
+			uint32_t vertexFormat;
+
+			uint32_t indexOffsetByte;
+			uint32_t indexType; // INDEX_TYPE_*
+
+			// Start of each attribute stream in attributeBuffer (4 byte words), VERTEX_ATTRIBUTE_NONE if not stored
+			uint32_t attributeOffsets[VERTEX_ATTRIBUTE_COUNT];
+
+			// Material ranges in materialRangeBuffer
+			uint32_t materialRangeOffset;
+			uint32_t materialRangeCount;
+		};
+
+		// Triangles [firstPrim, next range's firstPrim) use materialIndex
+		struct MaterialRange {
+			uint32_t firstPrim;
+			uint32_t materialIndex;
+		};
+
+		// GeometryData::indexType, geometries with at most 65536 vertices use 16-bit indices
+		enum IndexType : uint32_t {
+			INDEX_TYPE_UINT32 = 0,
+			INDEX_TYPE_UINT16 = 1,
 		};
 
 		struct GeometryBufferData {
-			uint32_t vertexOffsetByte;
+			uint32_t positionOffsetByte;
 			uint32_t indexOffsetByte;
+			vk::IndexType indexType;
 
 			uint32_t numVert;
 			uint32_t numIndex;
@@ -34,22 +64,76 @@ namespace Skhole {
 			scene = in_scene;
 		}
 
-		void InitGeometryBuffer(vk::PhysicalDevice physicalDevice, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
+		// Call before InitGeometryBuffer.
+		// format : encoding of the attribute streams, the shader has to decode it
+		void SetVertexFormat(VertexFormat format) {
+			vertexFormat = format;
+		}
+
+		// Call before InitGeometryBuffer.
+		// attributeMask : VERTEX_ATTRIBUTE_BIT_*, streams the shaders read. Others are not stored.
+		void SetVertexAttributes(uint32_t attributeMask) {
+			vertexAttributeMask = attributeMask;
+		}
+
+		void InitGeometryBuffer(vk::PhysicalDevice physicalDevice, vk::Device device, UploadManager& uploadManager) {
 
-			auto geometries = scene->m_geometies;
+			auto& geometries = scene->m_geometies;
 
 			uint32_t vertexCount = 0;
 			uint32_t indexCount = 0;
-			uint32_t matIndexCount = 0;
+			uint32_t attributeWordCount = 0;
+			uint32_t indexByteCount = 0;
 
+			// Layout
 			for (auto& geometry : geometries) {
 				auto& vertices = geometry->m_vertices;
 				auto& indices = geometry->m_indices;
 				auto& matIndices = geometry->m_materialIndices;
 
+				GeometryData geomData;
+				geomData.vertexOffset = vertexCount;
+				geomData.indexOffset = indexCount;
+				geomData.vertexFormat = static_cast<uint32_t>(vertexFormat);
+
+				// 4 byte aligned, so 32-bit geometries stay aligned after 16-bit ones
+				bool index16 = vertices.size() <= 0x10000;
+				geomData.indexType = index16 ? INDEX_TYPE_UINT16 : INDEX_TYPE_UINT32;
+				geomData.indexOffsetByte = indexByteCount;
+				indexByteCount += (uint32_t)indices.size() * (index16 ? sizeof(uint16_t) : sizeof(uint32_t));
+				indexByteCount = (indexByteCount + 3) & ~3u;
+
+				for (uint32_t attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+					if (vertexAttributeMask & (1u << attribute)) {
+						geomData.attributeOffsets[attribute] = attributeWordCount;
+						attributeWordCount += (uint32_t)vertices.size() * GetVertexAttributeWordCount(VertexAttribute(attribute), vertexFormat);
+					}
+					else {
+						geomData.attributeOffsets[attribute] = VERTEX_ATTRIBUTE_NONE;
+					}
+				}
+
+				// Loaders write materials per primitive or shape, so a geometry has a few runs
+				geomData.materialRangeOffset = (uint32_t)materialRanges.size();
+				for (uint32_t prim = 0; prim < matIndices.size(); prim++) {
+					if (prim == 0 || matIndices[prim] != matIndices[prim - 1]) {
+						materialRanges.push_back({ prim, matIndices[prim] });
+					}
+				}
+				geomData.materialRangeCount = (uint32_t)materialRanges.size() - geomData.materialRangeOffset;
+
+				geometryData.push_back(geomData);
+
+				GeometryBufferData geomOffset;
+				geomOffset.positionOffsetByte = vertexCount * sizeof(float) * 3;
+				geomOffset.indexOffsetByte = geomData.indexOffsetByte;
+				geomOffset.indexType = index16 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+				geomOffset.numVert = vertices.size();
+				geomOffset.numIndex = indices.size();
+				geometryOffset.push_back(geomOffset);
+
 				vertexCount += (uint32_t)vertices.size();
 				indexCount += (uint32_t)indices.size();
-				matIndexCount += (uint32_t)matIndices.size();
 			}
 
 			vk::BufferUsageFlags bufferUsage{
@@ -58,105 +142,129 @@ namespace Skhole {
 				vk::BufferUsageFlagBits::eShaderDeviceAddress
 			};
 
+			vk::BufferUsageFlags storageBufferUsage{
+				vk::BufferUsageFlagBits::eStorageBuffer |
+				vk::BufferUsageFlagBits::eShaderDeviceAddress
+			};
+
+			// Written through the staging ring of uploadManager, no host copy of the scene is kept
 			vk::MemoryPropertyFlags memoryProperty{
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+				vk::MemoryPropertyFlagBits::eDeviceLocal
 			};
 
-			vertexBuffer.Init(
+			// Positions only, read by the BLAS build
+			positionBuffer.InitDevice(
 				physicalDevice, device,
-				vertexCount * sizeof(VertexData),
+				vertexCount * sizeof(float) * 3,
 				bufferUsage, memoryProperty
 			);
 
-			indexBuffer.Init(
+			attributeBuffer.InitDevice(
 				physicalDevice, device,
-				indexCount * sizeof(uint32_t),
-				bufferUsage, memoryProperty
+				std::max(attributeWordCount, 1u) * sizeof(uint32_t),
+				storageBufferUsage, memoryProperty
 			);
 
-			matIndexBuffer.Init(
+			indexBuffer.InitDevice(
 				physicalDevice, device,
-				matIndexCount * sizeof(uint32_t),
+				std::max(indexByteCount, 4u),
 				bufferUsage, memoryProperty
 			);
 
-			uint32_t vertOffsetByte = 0;
-			uint32_t indexOffsetByte = 0;
-			uint32_t matIndexOffsetByte = 0;
+			materialRangeBuffer.InitDevice(
+				physicalDevice, device,
+				std::max<size_t>(materialRanges.size(), 1) * sizeof(MaterialRange),
+				storageBufferUsage, memoryProperty
+			);
 
-			uint32_t indexOffset = 0;
-			uint32_t vertexOffset = 0;
+			uint32_t geometryBufferSize = geometryData.size() * sizeof(GeometryData);
+			geometryBuffer.InitDevice(
+				physicalDevice, device,
+				geometryBufferSize,
+				storageBufferUsage, memoryProperty
+			);
 
-			for (auto& geometry : geometries) {
-				auto& vertices = geometry->m_vertices;
+			for (size_t geomIndex = 0; geomIndex < geometries.size(); geomIndex++) {
+				auto& geometry = geometries[geomIndex];
 				auto& indices = geometry->m_indices;
-				auto& matIndices = geometry->m_materialIndices;
+				const auto& geomData = geometryData[geomIndex];
+
+				StreamVertices(device, uploadManager, *geometry, geomData);
+
+				if (geomData.indexType == INDEX_TYPE_UINT16) {
+					uploadManager.Stream(device, indexBuffer.GetDeviceBuffer(), geomData.indexOffsetByte, indices.size() * sizeof(uint16_t), sizeof(uint16_t),
+						[&](void* staging, vk::DeviceSize offset, vk::DeviceSize size) {
+							uint16_t* dst = static_cast<uint16_t*>(staging);
+							const uint32_t* src = indices.data() + offset / sizeof(uint16_t);
+							ParallelFor(size / sizeof(uint16_t), 1 << 16, [&](size_t i) {
+								dst[i] = static_cast<uint16_t>(src[i]);
+								});
+						});
+				}
+				else {
+					uploadManager.Write(device, indexBuffer.GetDeviceBuffer(), geomData.indexOffsetByte, indices.data(), indices.size() * sizeof(uint32_t));
+				}
+			}
 
-				void* vertexMap = vertexBuffer.Map(device, vertOffsetByte, vertices.size() * sizeof(VertexData));
-				void* indexMap = indexBuffer.Map(device, indexOffsetByte, indices.size() * sizeof(uint32_t));
-				void* matIndexMap = matIndexBuffer.Map(device, matIndexOffsetByte, geometry->m_materialIndices.size() * sizeof(uint32_t));
+			uploadManager.Write(device, materialRangeBuffer.GetDeviceBuffer(), 0, materialRanges.data(), materialRanges.size() * sizeof(MaterialRange));
+			uploadManager.Write(device, geometryBuffer.GetDeviceBuffer(), 0, geometryData.data(), geometryBufferSize);
 
-				memcpy(vertexMap, vertices.data(), vertices.size() * sizeof(VertexData));
-				memcpy(indexMap, indices.data(), indices.size() * sizeof(uint32_t));
-				memcpy(matIndexMap, matIndices.data(), matIndices.size() * sizeof(uint32_t));
+			SKHOLE_LOG("Vertex Buffer : " << VertexFormat2Name(vertexFormat) << ", " << vertexCount << " vertices, position "
+				<< (double(vertexCount) * sizeof(float) * 3) / (1024.0 * 1024.0) << " MB, attribute "
+				<< (double(attributeWordCount) * sizeof(uint32_t)) / (1024.0 * 1024.0) << " MB");
+			SKHOLE_LOG("Index Buffer : " << indexCount << " indices, " << double(indexByteCount) / (1024.0 * 1024.0) << " MB ("
+				<< double(indexCount) * sizeof(uint32_t) / (1024.0 * 1024.0) << " MB with 32-bit indices)");
+			SKHOLE_LOG("Material Ranges : " << materialRanges.size() << " ranges for " << indexCount / 3 << " triangles");
+		}
 
-				vertexBuffer.Unmap(device);
-				indexBuffer.Unmap(device);
-				matIndexBuffer.Unmap(device);
+		// Uploads the vertices of animated geometries marked isVertexUpdated into their existing range.
+		// Returns the updated geometry indices, their BLASes have to be refit with ASManager::UpdateBLAS after UploadManager::Flush.
+		std::vector<uint32_t> FrameUpdateGeometry(vk::Device device, UploadManager& uploadManager) {
+			auto& geometries = scene->m_geometies;
+			std::vector<uint32_t> updatedGeometries;
 
-				GeometryData geomData;
-				geomData.vertexOffset = vertexOffset;
-				geomData.indexOffset = indexOffset;
-				geometryData.push_back(geomData);
+			for (uint32_t geomIndex = 0; geomIndex < geometries.size(); geomIndex++) {
+				auto& geometry = geometries[geomIndex];
+				if (!geometry->useAnimation || !geometry->isVertexUpdated) continue;
 
-				GeometryBufferData geomOffset;
-				geomOffset.vertexOffsetByte = vertOffsetByte;
-				geomOffset.indexOffsetByte = indexOffsetByte;
-				geomOffset.numVert = vertices.size();
-				geomOffset.numIndex = indices.size();
-				geometryOffset.push_back(geomOffset);
-
-				vertOffsetByte += vertices.size() * sizeof(VertexData);
-				indexOffsetByte += indices.size() * sizeof(uint32_t);
-				matIndexOffsetByte += matIndices.size() * sizeof(uint32_t);
+				geometry->isVertexUpdated = false;
+				if (geometry->m_vertices.size() != geometryOffset[geomIndex].numVert) {
+					SKHOLE_WARN("Animated geometry " << geomIndex << " changed its vertex count, the update is skipped");
+					continue;
+				}
 
-				indexOffset += indices.size();
-				vertexOffset += vertices.size();
+				updatedGeometries.push_back(geomIndex);
 			}
 
-			vertexBuffer.UploadToDevice(device, commandPool, queue);
-			indexBuffer.UploadToDevice(device, commandPool, queue);
-			matIndexBuffer.UploadToDevice(device, commandPool, queue);
-
-			vk::BufferUsageFlags geometryBufferUsage{
-				vk::BufferUsageFlagBits::eStorageBuffer |
-				vk::BufferUsageFlagBits::eShaderDeviceAddress
-			};
-
-			vk::MemoryPropertyFlags geometryBufferProperty{
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-			};
-
-			uint32_t geometryBufferSize = geometryData.size() * sizeof(GeometryData);
-			geometryBuffer.Init(
-				physicalDevice, device,
-				geometryBufferSize,
-				geometryBufferUsage, geometryBufferProperty
-			);
-
-			void* geometryMap = geometryBuffer.Map(device, 0, geometryBufferSize);
-			memcpy(geometryMap, geometryData.data(), geometryBufferSize);
-			geometryBuffer.Unmap(device);
+			for (auto geomIndex : updatedGeometries) {
+				StreamVertices(device, uploadManager, *geometries[geomIndex], geometryData[geomIndex]);
+			}
 
-			geometryBuffer.UploadToDevice(device, commandPool, queue);
+			return updatedGeometries;
 		}
 
-		void InitInstanceBuffer(vk::PhysicalDevice physicalDevice, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
+		// numFrame : one slice per frame in flight, bound with the dynamic offset of the frame
+		void InitInstanceBuffer(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t numFrame = 1) {
 			auto& objects = scene->m_objects;
 
 			for (auto& object : objects) {
 				if (ObjectType::INSTANCE == object->GetObjectType()) {
 					auto instance = std::static_pointer_cast<Instance>(object);
+					if (!instance->geometryIndex.has_value()) continue;
+
+					uint32_t index = instanceData.size();
+					instanceObjects.push_back(instance);
+					instanceIndices[instance.get()] = index;
+
+					// Animation of the instance or of a parent moves it every frame
+					bool dynamic = false;
+					for (Object* obj = instance.get(); obj != nullptr; obj = obj->parentObject.get()) {
+						dynamic |= obj->useAnimation;
+					}
+					if (dynamic) dynamicInstances.push_back(index);
+
+					// Every transform is evaluated by the first FrameUpdateInstance
+					staleInstances.push_back(index);
 
 					InstanceData instData;
 					instData.geometryIndex = instance->geometryIndex.value();
@@ -177,95 +285,217 @@ namespace Skhole {
 				}
 			}
 
-			vk::BufferUsageFlags bufferUsage{
-				vk::BufferUsageFlagBits::eStorageBuffer |
-				vk::BufferUsageFlagBits::eShaderDeviceAddress
-			};
-
-			vk::MemoryPropertyFlags memoryProperty{
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-			};
-
-			uint32_t instanceBufferSize = instanceData.size() * sizeof(InstanceData);
-
+			// Keep one element so the buffer is valid for an empty scene
+			vk::DeviceSize instanceBufferSize = std::max<size_t>(instanceData.size(), 1) * sizeof(InstanceData);
 			instanceBuffer.Init(
 				physicalDevice, device,
 				instanceBufferSize,
-				bufferUsage, memoryProperty
+				vk::BufferUsageFlagBits::eStorageBuffer,
+				numFrame
 			);
 
-			void* instanceMap = instanceBuffer.Map(device, 0, instanceBufferSize);
-			memcpy(instanceMap, instanceData.data(), instanceBufferSize);
-			instanceBuffer.Unmap(device);
+			numInstanceSlice = numFrame;
+			pendingSlices.assign(instanceData.size(), 0);
 
-			instanceBuffer.UploadToDevice(device, commandPool, queue);
-		}
-
-		void FrameUpdateInstance(float frame, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
-			auto& objects = scene->m_objects;
-			uint32_t numInstance = instanceData.size();
-			instanceData.clear();
-			instanceData.reserve(numInstance);
+			instanceSetChanged = true;
+			instanceMoved.assign(instanceData.size(), 0);
+			movedInstances.clear();
 
-			for (auto& object : objects) {
-				if (ObjectType::INSTANCE == object->GetObjectType()) {
-					auto instance = std::static_pointer_cast<Instance>(object);
+			for (uint32_t frameIndex = 0; frameIndex < numFrame; frameIndex++) {
+				memcpy(instanceBuffer.GetSlice(frameIndex), instanceData.data(), instanceData.size() * sizeof(InstanceData));
+			}
+		}
 
-					InstanceData instData;
-					instData.geometryIndex = instance->geometryIndex.value();
+		// The shaders read the slice of frameIndex from host visible memory, nothing is copied.
+		// The slice must not be in use by a frame in flight.
+		// Only animated instances and the ones marked by MarkObjectDirty are evaluated,
+		// a changed instance is written to each slice once.
+		void FrameUpdateInstance(float frame, vk::Device device, uint32_t frameIndex = 0) {
+			for (uint32_t index : dynamicInstances) UpdateInstanceData(index, frame);
+			for (uint32_t index : staleInstances) UpdateInstanceData(index, frame);
+			staleInstances.clear();
 
-					mat4 transform = instance->GetWorldTransformMatrix(frame);
-					mat3 normalTransform = NormalTransformMatrix3x3(transform);
+			WriteInstanceBuffer(device, frameIndex);
+		}
 
-					instData.transform = std::array{
-						std::array{transform[0][0], transform[0][1], transform[0][2], transform[0][3]},
-						std::array{transform[1][0], transform[1][1], transform[1][2], transform[1][3]},
-						std::array{transform[2][0], transform[2][1], transform[2][2], transform[2][3]}
-					};
+		// Transform of the object was edited, its instance and the child instances are evaluated by the next FrameUpdateInstance
+		void MarkObjectDirty(uint32_t objectIndex) {
+			for (Object* obj = scene->m_objects[objectIndex].get(); obj != nullptr; obj = obj->childObject.get()) {
+				auto itr = instanceIndices.find(obj);
+				if (itr != instanceIndices.end()) staleInstances.push_back(itr->second);
+			}
+		}
 
+		FrameRingBuffer& GetInstanceBuffer() {
+			return instanceBuffer;
+		}
 
-					instData.normalTransform = std::array{
-						std::array{normalTransform[0][0], normalTransform[0][1], normalTransform[0][2], 0.0f},
-						std::array{normalTransform[1][0], normalTransform[1][1], normalTransform[1][2], 0.0f},
-						std::array{normalTransform[2][0], normalTransform[2][1], normalTransform[2][2], 0.0f}
-					};
+		// Called by ASManager::BuildTLAS once the changes are in the TLAS
+		void ClearInstanceChanges() {
+			for (uint32_t index : movedInstances) instanceMoved[index] = 0;
+			movedInstances.clear();
+			instanceSetChanged = false;
+		}
 
-					instanceData.push_back(instData);
-				}
+		// Animated geometries waiting for FrameUpdateGeometry
+		bool HasGeometryUpdate() {
+			for (auto& geometry : scene->m_geometies) {
+				if (geometry->useAnimation && geometry->isVertexUpdated) return true;
 			}
-
-			void* instanceMap = instanceBuffer.Map(device, 0, instanceBuffer.GetBufferSize());
-			memcpy(instanceMap, instanceData.data(), instanceBuffer.GetBufferSize());
-			instanceBuffer.Unmap(device);
-
-			instanceBuffer.UploadToDevice(device, commandPool, queue);
+			return false;
 		}
 
 		void Release(vk::Device device) {
-			vertexBuffer.Release(device);
+			positionBuffer.Release(device);
+			attributeBuffer.Release(device);
 			indexBuffer.Release(device);
 
 			geometryBuffer.Release(device);
 			instanceBuffer.Release(device);
 
+			materialRangeBuffer.Release(device);
+
 			geometryOffset.clear();
 			geometryData.clear();
+			materialRanges.clear();
 			instanceData.clear();
+
+			instanceObjects.clear();
+			instanceIndices.clear();
+			dynamicInstances.clear();
+			staleInstances.clear();
+			pendingSlices.clear();
+			pendingInstances.clear();
+
+			instanceSetChanged = true;
+			instanceMoved.clear();
+			movedInstances.clear();
 		}
 
-		DeviceBuffer vertexBuffer;
+	private:
+		// Evaluates instanceData[index] at frame, a changed instance is pending for every slice
+		void UpdateInstanceData(uint32_t index, float frame) {
+			auto& instance = instanceObjects[index];
+
+			InstanceData instData;
+			instData.geometryIndex = instance->geometryIndex.value();
+
+			mat4 transform = instance->GetWorldTransformMatrix(frame);
+			mat3 normalTransform = NormalTransformMatrix3x3(transform);
+
+			instData.transform = std::array{
+				std::array{transform[0][0], transform[0][1], transform[0][2], transform[0][3]},
+				std::array{transform[1][0], transform[1][1], transform[1][2], transform[1][3]},
+				std::array{transform[2][0], transform[2][1], transform[2][2], transform[2][3]}
+			};
+
+			instData.normalTransform = std::array{
+				std::array{normalTransform[0][0], normalTransform[0][1], normalTransform[0][2], 0.0f},
+				std::array{normalTransform[1][0], normalTransform[1][1], normalTransform[1][2], 0.0f},
+				std::array{normalTransform[2][0], normalTransform[2][1], normalTransform[2][2], 0.0f}
+			};
+
+			if (memcmp(&instData, &instanceData[index], sizeof(InstanceData)) == 0) return;
+			instanceData[index] = instData;
+
+			if (pendingSlices[index] == 0) pendingInstances.push_back(index);
+			pendingSlices[index] = (1u << numInstanceSlice) - 1;
+
+			if (!instanceMoved[index]) {
+				instanceMoved[index] = 1;
+				movedInstances.push_back(index);
+			}
+		}
+
+		// Writes the pending instances of the slice of frameIndex
+		void WriteInstanceBuffer(vk::Device device, uint32_t frameIndex) {
+			if (pendingInstances.empty()) return;
+
+			InstanceData* slice = static_cast<InstanceData*>(instanceBuffer.GetSlice(frameIndex));
+			uint32_t sliceBit = 1u << frameIndex;
+			for (uint32_t index : pendingInstances) {
+				if ((pendingSlices[index] & sliceBit) == 0) continue;
+				slice[index] = instanceData[index];
+				pendingSlices[index] &= ~sliceBit;
+			}
+
+			pendingInstances.erase(
+				std::remove_if(pendingInstances.begin(), pendingInstances.end(), [&](uint32_t index) { return pendingSlices[index] == 0; }),
+				pendingInstances.end());
+		}
+
+		// Positions and attribute streams of one geometry, written through the staging ring of uploadManager
+		void StreamVertices(vk::Device device, UploadManager& uploadManager, const Geometry& geometry, const GeometryData& geomData) {
+			auto& vertices = geometry.m_vertices;
+
+			const vk::DeviceSize positionStride = sizeof(float) * 3;
+			uploadManager.Stream(device, positionBuffer.GetDeviceBuffer(), geomData.vertexOffset * positionStride, vertices.size() * positionStride, positionStride,
+				[&](void* staging, vk::DeviceSize offset, vk::DeviceSize size) {
+					size_t first = offset / positionStride;
+					ParallelForChunk(size / positionStride, 1 << 14, [&](size_t, size_t begin, size_t end) {
+						float* position = static_cast<float*>(staging) + begin * 3;
+						for (size_t i = first + begin; i < first + end; i++) {
+							*position++ = vertices[i].position.x;
+							*position++ = vertices[i].position.y;
+							*position++ = vertices[i].position.z;
+						}
+						});
+				});
+
+			for (uint32_t attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+				if (geomData.attributeOffsets[attribute] == VERTEX_ATTRIBUTE_NONE) continue;
+
+				uint32_t wordCount = GetVertexAttributeWordCount(VertexAttribute(attribute), vertexFormat);
+				vk::DeviceSize stride = wordCount * sizeof(uint32_t);
+				uploadManager.Stream(device, attributeBuffer.GetDeviceBuffer(), geomData.attributeOffsets[attribute] * sizeof(uint32_t), vertices.size() * stride, stride,
+					[&](void* staging, vk::DeviceSize offset, vk::DeviceSize size) {
+						size_t first = offset / stride;
+						ParallelForChunk(size / stride, 1 << 14, [&](size_t, size_t begin, size_t end) {
+							uint32_t* dst = static_cast<uint32_t*>(staging) + begin * wordCount;
+							WriteVertexAttribute(VertexAttribute(attribute), vertexFormat, vertices.data() + first + begin, end - begin, dst);
+							});
+					});
+			}
+		}
+
+	public:
+		VertexFormat vertexFormat = VertexFormat::STANDARD;
+		uint32_t vertexAttributeMask = VERTEX_ATTRIBUTE_BIT_ALL;
+
+		DeviceBuffer positionBuffer;
+		DeviceBuffer attributeBuffer;
 		DeviceBuffer indexBuffer;
-		DeviceBuffer matIndexBuffer;
+		DeviceBuffer materialRangeBuffer;
 
 		std::vector<GeometryData> geometryData;
+		std::vector<MaterialRange> materialRanges;
 		std::vector<GeometryBufferData> geometryOffset;
 
 		std::vector<InstanceData> instanceData;
 
+		// Changes not in the TLAS yet, cleared by ClearInstanceChanges
+		bool instanceSetChanged = true;
+		std::vector<uint32_t> movedInstances;
+
 		DeviceBuffer geometryBuffer;
-		DeviceBuffer instanceBuffer;
+		FrameRingBuffer instanceBuffer;
 
 		ShrPtr<Scene> scene = nullptr;
+
+	private:
+		// Same order as instanceData
+		std::vector<ShrPtr<Instance>> instanceObjects;
+		std::unordered_map<const Object*, uint32_t> instanceIndices;
+
+		std::vector<uint32_t> dynamicInstances;
+		std::vector<uint32_t> staleInstances;
+
+		// Bit i : the slice of frame i does not have instanceData[index] yet
+		uint32_t numInstanceSlice = 1;
+		std::vector<uint32_t> pendingSlices;
+		std::vector<uint32_t> pendingInstances;
+
+		std::vector<uint8_t> instanceMoved;
 	};
 
 	class ASManager {
@@ -273,100 +503,531 @@ namespace Skhole {
 		ASManager() {};
 		~ASManager() {};
 
+		// All BLASes are built with a few submits sharing one scratch buffer, then compacted.
+		// BLASes of animated geometries allow update and are not compacted, so UpdateBLAS can refit or rebuild them in place.
 		void BuildBLAS(SceneBufferaManager& bufferManager, vk::PhysicalDevice physicalDevice, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
 			auto& geomOffset = bufferManager.geometryOffset;
+			auto& sceneGeometries = bufferManager.scene->m_geometies;
+			const uint32_t numBLAS = (uint32_t)geomOffset.size();
 			BLASes.clear();
-			BLASes.resize(geomOffset.size());
-
-			for (int i = 0; i < geomOffset.size(); i++) {
-				auto& geom = geomOffset[i];
-				vk::AccelerationStructureGeometryTrianglesDataKHR triangles{};
-				triangles.setVertexFormat(vk::Format::eR32G32B32Sfloat);
-				triangles.setVertexData(bufferManager.vertexBuffer.GetDeviceAddress() + geom.vertexOffsetByte);
-				triangles.setVertexStride(sizeof(VertexData));
-				triangles.setMaxVertex(geom.numVert);
-				triangles.setIndexType(vk::IndexType::eUint32);
-				triangles.setIndexData(bufferManager.indexBuffer.GetDeviceAddress() + geom.indexOffsetByte);
-
-				vk::AccelerationStructureGeometryKHR geometry{};
-				geometry.setGeometryType(vk::GeometryTypeKHR::eTriangles);
-				geometry.setGeometry({ triangles });
-				geometry.setFlags(vk::GeometryFlagBitsKHR::eOpaque);
-
-				uint32_t primitiveCount = geom.numIndex / 3;
-
-				BLASes[i].init(physicalDevice, device, commandPool, queue,
+			blasUpdateStates.clear();
+
+			// New BLASes may reuse old addresses, so the next TLAS is always fully built
+			tlasBuilt = false;
+			if (numBLAS == 0) return;
+
+			Timer timer;
+			timer.Start();
+
+			auto asProperties = vkutils::getAccelerationStructureProps(physicalDevice);
+			scratchAlignment = std::max<vk::DeviceSize>(asProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+			std::vector<vk::AccelerationStructureGeometryKHR> geometries(numBLAS);
+			std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> buildInfos(numBLAS);
+			std::vector<vk::AccelerationStructureBuildRangeInfoKHR> buildRanges(numBLAS);
+			std::vector<vk::DeviceSize> scratchSizes(numBLAS);
+			std::vector<AccelStruct> buildBLASes(numBLAS);
+
+			// Compacted size query index of each BLAS, animated BLASes have none
+			std::vector<uint32_t> queryIndices(numBLAS);
+			uint32_t numQuery = 0;
+
+			blasUpdateStates.resize(numBLAS);
+			vk::DeviceSize updateScratchSize = 0;
+
+			vk::DeviceSize buildSize = 0;
+			for (uint32_t i = 0; i < numBLAS; i++) {
+				auto& updateState = blasUpdateStates[i];
+				updateState.updatable = sceneGeometries[i]->useAnimation;
+
+				geometries[i] = GetBLASGeometry(bufferManager, i);
+				buildRanges[i] = GetBLASBuildRange(bufferManager, i);
+
+				auto& buildInfo = buildInfos[i];
+				buildInfo.setType(vk::AccelerationStructureTypeKHR::eBottomLevel);
+				buildInfo.setMode(vk::BuildAccelerationStructureModeKHR::eBuild);
+				buildInfo.setFlags(GetBLASBuildFlags(updateState.updatable));
+				buildInfo.setGeometries(geometries[i]);
+
+				vk::AccelerationStructureBuildSizesInfoKHR buildSizes =
+					device.getAccelerationStructureBuildSizesKHR(
+						vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo,
+						buildRanges[i].primitiveCount);
+
+				buildBLASes[i].Create(physicalDevice, device,
 					vk::AccelerationStructureTypeKHR::eBottomLevel,
-					geometry, primitiveCount);
+					buildSizes.accelerationStructureSize);
+				buildInfo.setDstAccelerationStructure(*buildBLASes[i].accel);
+
+				scratchSizes[i] = AlignScratch(buildSizes.buildScratchSize);
+				buildSize += buildBLASes[i].GetSize();
+
+				if (updateState.updatable) {
+					updateState.scratchOffset = updateScratchSize;
+					updateState.buildArea = GetBoundsArea(*sceneGeometries[i]);
+					updateScratchSize += AlignScratch(std::max(buildSizes.buildScratchSize, buildSizes.updateScratchSize));
+				}
+				else {
+					queryIndices[i] = numQuery++;
+				}
+			}
+
+			// Split into batches whose scratch fits in the shared buffer.
+			// A BLAS larger than the budget gets a batch of its own.
+			struct Batch {
+				uint32_t first;
+				uint32_t count;
+			};
+			std::vector<Batch> batches;
+			vk::DeviceSize scratchSize = 0;
+			{
+				Batch batch{ 0, 0 };
+				vk::DeviceSize batchScratch = 0;
+				for (uint32_t i = 0; i < numBLAS; i++) {
+					if (batch.count > 0 && batchScratch + scratchSizes[i] > MAX_BLAS_SCRATCH_SIZE) {
+						batches.push_back(batch);
+						batch = { i, 0 };
+						batchScratch = 0;
+					}
+					batch.count++;
+					batchScratch += scratchSizes[i];
+					scratchSize = std::max(scratchSize, batchScratch);
+				}
+				batches.push_back(batch);
+			}
+
+			Buffer scratchBuffer;
+			scratchBuffer.Init(physicalDevice, device, scratchSize + scratchAlignment,
+				vk::BufferUsageFlagBits::eStorageBuffer |
+				vk::BufferUsageFlagBits::eShaderDeviceAddress,
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				nullptr, MemoryLifetime::Transient);
+			const vk::DeviceAddress scratchBase = AlignScratch(scratchBuffer.address);
+
+			vk::UniqueQueryPool queryPool;
+			if (numQuery > 0) {
+				vk::QueryPoolCreateInfo queryPoolInfo{};
+				queryPoolInfo.setQueryType(vk::QueryType::eAccelerationStructureCompactedSizeKHR);
+				queryPoolInfo.setQueryCount(numQuery);
+				queryPool = device.createQueryPoolUnique(queryPoolInfo);
+			}
+
+			// Build, the scratch buffer is reused by the next batch after the submit has finished
+			for (auto& batch : batches) {
+				std::vector<const vk::AccelerationStructureBuildRangeInfoKHR*> rangePtrs(batch.count);
+				std::vector<vk::AccelerationStructureKHR> queryAccels;
+				uint32_t firstQuery = numQuery;
+
+				vk::DeviceSize scratchOffset = 0;
+				for (uint32_t j = 0; j < batch.count; j++) {
+					uint32_t i = batch.first + j;
+					buildInfos[i].setScratchData(scratchBase + scratchOffset);
+					scratchOffset += scratchSizes[i];
+					rangePtrs[j] = &buildRanges[i];
+
+					if (!blasUpdateStates[i].updatable) {
+						if (queryAccels.empty()) firstQuery = queryIndices[i];
+						queryAccels.push_back(*buildBLASes[i].accel);
+					}
+				}
+
+				vkutils::oneTimeSubmit(
+					device, commandPool, queue,
+					[&](vk::CommandBuffer commandBuffer) {
+						if (!queryAccels.empty()) {
+							commandBuffer.resetQueryPool(*queryPool, firstQuery, (uint32_t)queryAccels.size());
+						}
+
+						commandBuffer.buildAccelerationStructuresKHR(batch.count, buildInfos.data() + batch.first, rangePtrs.data());
+
+						if (!queryAccels.empty()) {
+							vk::MemoryBarrier barrier{};
+							barrier.setSrcAccessMask(vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+							barrier.setDstAccessMask(vk::AccessFlagBits::eAccelerationStructureReadKHR);
+							commandBuffer.pipelineBarrier(
+								vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+								vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+								{}, barrier, {}, {});
+
+							commandBuffer.writeAccelerationStructuresPropertiesKHR(
+								queryAccels, vk::QueryType::eAccelerationStructureCompactedSizeKHR,
+								*queryPool, firstQuery);
+						}
+					});
+			}
+
+			scratchBuffer.Release(device);
+
+			if (updateScratchSize > 0) {
+				blasUpdateScratchBuffer.Init(physicalDevice, device, updateScratchSize + scratchAlignment,
+					vk::BufferUsageFlagBits::eStorageBuffer |
+					vk::BufferUsageFlagBits::eShaderDeviceAddress,
+					vk::MemoryPropertyFlagBits::eDeviceLocal);
 			}
+
+			// Compaction
+			std::vector<vk::DeviceSize> compactSizes(numQuery);
+			bool compaction = numQuery > 0;
+			if (compaction) {
+				vk::Result result = device.getQueryPoolResults(
+					*queryPool, 0, numQuery,
+					numQuery * sizeof(vk::DeviceSize), compactSizes.data(), sizeof(vk::DeviceSize),
+					vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+				if (result != vk::Result::eSuccess) {
+					SKHOLE_WARN("BLAS compaction query failed, compaction is skipped");
+					compaction = false;
+				}
+			}
+
+			if (!compaction) {
+				for (auto& blas : buildBLASes) blas.UpdateAddress(device);
+				BLASes = std::move(buildBLASes);
+				SKHOLE_LOG("Build BLAS : " << numBLAS << " BLASes in " << batches.size() << " batches, "
+					<< buildSize / (1024.0 * 1024.0) << " MB, " << timer.Stop() << " s");
+				return;
+			}
+
+			BLASes.resize(numBLAS);
+			vk::DeviceSize compactSize = 0;
+			for (uint32_t i = 0; i < numBLAS; i++) {
+				if (blasUpdateStates[i].updatable) {
+					BLASes[i] = std::move(buildBLASes[i]);
+				}
+				else {
+					BLASes[i].Create(physicalDevice, device,
+						vk::AccelerationStructureTypeKHR::eBottomLevel,
+						compactSizes[queryIndices[i]]);
+				}
+				compactSize += BLASes[i].GetSize();
+			}
+
+			vkutils::oneTimeSubmit(
+				device, commandPool, queue,
+				[&](vk::CommandBuffer commandBuffer) {
+					for (uint32_t i = 0; i < numBLAS; i++) {
+						if (blasUpdateStates[i].updatable) continue;
+
+						vk::CopyAccelerationStructureInfoKHR copyInfo{};
+						copyInfo.setSrc(*buildBLASes[i].accel);
+						copyInfo.setDst(*BLASes[i].accel);
+						copyInfo.setMode(vk::CopyAccelerationStructureModeKHR::eCompact);
+						commandBuffer.copyAccelerationStructureKHR(copyInfo);
+					}
+				});
+
+			for (uint32_t i = 0; i < numBLAS; i++) {
+				if (!blasUpdateStates[i].updatable) buildBLASes[i].Release(device);
+			}
+			for (auto& blas : BLASes) blas.UpdateAddress(device);
+
+			SKHOLE_LOG("Build BLAS : " << numBLAS << " BLASes in " << batches.size() << " batches, "
+				<< buildSize / (1024.0 * 1024.0) << " MB -> " << compactSize / (1024.0 * 1024.0) << " MB compacted, "
+				<< timer.Stop() << " s");
 		}
 
-		void UpdateBLAS() {
-			SKHOLE_UNIMPL("Update BLAS");
+		// Refits the BLASes of geometries whose vertices were uploaded by SceneBufferaManager::FrameUpdateGeometry.
+		// A BLAS is rebuilt in place instead after MAX_BLAS_REFIT_COUNT refits, or when the bounds of the geometry
+		// grew by more than BLAS_REFIT_AREA_RATIO since the last build, as the refit boxes get loose.
+		void UpdateBLAS(SceneBufferaManager& bufferManager, const std::vector<uint32_t>& geometryIndices, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
+			if (geometryIndices.empty()) return;
+
+			auto& sceneGeometries = bufferManager.scene->m_geometies;
+			const vk::DeviceAddress scratchBase = AlignScratch(blasUpdateScratchBuffer.address);
+
+			std::vector<vk::AccelerationStructureGeometryKHR> geometries(geometryIndices.size());
+			std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> buildInfos;
+			std::vector<vk::AccelerationStructureBuildRangeInfoKHR> buildRanges(geometryIndices.size());
+			std::vector<const vk::AccelerationStructureBuildRangeInfoKHR*> rangePtrs;
+			uint32_t numRebuild = 0;
+
+			for (size_t j = 0; j < geometryIndices.size(); j++) {
+				uint32_t i = geometryIndices[j];
+				if (i >= blasUpdateStates.size() || !blasUpdateStates[i].updatable) {
+					SKHOLE_WARN("BLAS " << i << " is not updatable, the geometry has to be animated when the BLAS is built");
+					continue;
+				}
+
+				auto& updateState = blasUpdateStates[i];
+
+				// Skinned vertices are posed on the GPU and m_vertices stays in the bind pose, only the refit count applies
+				bool skinned = sceneGeometries[i]->skinIndex.has_value();
+				float area = skinned ? updateState.buildArea : GetBoundsArea(*sceneGeometries[i]);
+				bool rebuild = updateState.refitCount >= MAX_BLAS_REFIT_COUNT || area > updateState.buildArea * BLAS_REFIT_AREA_RATIO;
+
+				geometries[j] = GetBLASGeometry(bufferManager, i);
+				buildRanges[j] = GetBLASBuildRange(bufferManager, i);
+
+				vk::AccelerationStructureBuildGeometryInfoKHR buildInfo{};
+				buildInfo.setType(vk::AccelerationStructureTypeKHR::eBottomLevel);
+				buildInfo.setFlags(GetBLASBuildFlags(true));
+				buildInfo.setGeometries(geometries[j]);
+				buildInfo.setDstAccelerationStructure(*BLASes[i].accel);
+				buildInfo.setScratchData(scratchBase + updateState.scratchOffset);
+
+				if (rebuild) {
+					buildInfo.setMode(vk::BuildAccelerationStructureModeKHR::eBuild);
+					updateState.refitCount = 0;
+					updateState.buildArea = area;
+					numRebuild++;
+				}
+				else {
+					buildInfo.setMode(vk::BuildAccelerationStructureModeKHR::eUpdate);
+					buildInfo.setSrcAccelerationStructure(*BLASes[i].accel);
+					updateState.refitCount++;
+				}
+
+				buildInfos.push_back(buildInfo);
+				rangePtrs.push_back(&buildRanges[j]);
+			}
+
+			if (buildInfos.empty()) return;
+
+			// Every BLAS has its own scratch range, so all of them go into one build call
+			vkutils::oneTimeSubmit(
+				device, commandPool, queue,
+				[&](vk::CommandBuffer commandBuffer) {
+					commandBuffer.buildAccelerationStructuresKHR((uint32_t)buildInfos.size(), buildInfos.data(), rangePtrs.data());
+				});
+
+			// The BLAS addresses are unchanged but their bounds moved
+			tlasNeedsRefit = true;
+
+			if (numRebuild > 0) {
+				SKHOLE_LOG("Update BLAS : " << buildInfos.size() - numRebuild << " refit, " << numRebuild << " rebuilt");
+			}
 		}
 
+		// The TLAS is kept across frames, the change set of bufferManager decides the build.
+		// Nothing moved -> no build, only transforms changed -> eUpdate, instance set changed -> full build
 		void BuildTLAS(SceneBufferaManager& bufferManager, vk::PhysicalDevice physicalDevice, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
 			uint32_t instanceCount = bufferManager.instanceData.size();
-			std::vector<vk::AccelerationStructureInstanceKHR> accels;
-			accels.reserve(instanceCount);
-
-			for (int i = 0; i < bufferManager.instanceData.size(); i++) {
-				auto& inst = bufferManager.instanceData[i];
-				vk::AccelerationStructureInstanceKHR accel{};
-				//vk::TransformMatrixKHR transform = std::array{
-				//	std::array{ 1.0f, 0.0f, 0.0f, 0.0f }, 
-				//	std::array{ 0.0f, 1.0f, 0.0f, 0.0f }, 
-				//	std::array{ 0.0f, 0.0f, 1.0f, 0.0f }, 
-				//};
-				//accel.setTransform(transform);
-				accel.setTransform(inst.transform);
-				accel.setInstanceCustomIndex(i);
-				accel.setMask(0xff);
-				accel.setInstanceShaderBindingTableRecordOffset(0);
-				accel.setFlags(vk::GeometryInstanceFlagBitsKHR::eTriangleCullDisable);
-				accel.setAccelerationStructureReference(BLASes[inst.geometryIndex].buffer.address);
-
-				accels.push_back(accel);
-			}
-
-			Buffer instanceBuffer;
-			instanceBuffer.Init(physicalDevice, device,
-				sizeof(vk::AccelerationStructureInstanceKHR) * accels.size(),
-				vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-				accels.data()
-			);
+
+			TLASBuildType buildType = GetTLASBuildType(bufferManager);
+			if (buildType == TLAS_BUILD_NONE) return;
+
+			if (buildType == TLAS_BUILD_FULL) {
+				ReleaseTLAS(device);
+
+				// Keep at least one element so the buffer and the AS are valid for an empty scene
+				vk::DeviceSize instanceBufferSize = sizeof(vk::AccelerationStructureInstanceKHR) * std::max<size_t>(instanceCount, 1);
+				tlasInstanceBuffer.Init(physicalDevice, device,
+					instanceBufferSize,
+					vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+					vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+				);
+				tlasInstanceMap = static_cast<vk::AccelerationStructureInstanceKHR*>(tlasInstanceBuffer.Map(device, 0, instanceBufferSize));
+
+				for (uint32_t i = 0; i < instanceCount; i++) {
+					tlasInstanceMap[i] = GetTLASInstance(bufferManager, i);
+				}
+			}
+			else {
+				// Only the moved records are rewritten in the mapped buffer
+				for (uint32_t index : bufferManager.movedInstances) {
+					tlasInstanceMap[index].setTransform(bufferManager.instanceData[index].transform);
+				}
+			}
 
 			vk::AccelerationStructureGeometryInstancesDataKHR instancesData{};
 			instancesData.setArrayOfPointers(false);
-			instancesData.setData(instanceBuffer.address);
+			instancesData.setData(tlasInstanceBuffer.address);
 
 			vk::AccelerationStructureGeometryKHR ias{};
 			ias.setGeometryType(vk::GeometryTypeKHR::eInstances);
 			ias.setGeometry({ instancesData });
 			ias.setFlags(vk::GeometryFlagBitsKHR::eOpaque);
 
-			TLAS.init(
-				physicalDevice, device, commandPool, queue,
-				vk::AccelerationStructureTypeKHR::eTopLevel,
-				ias, instanceCount
-			);
+			vk::AccelerationStructureBuildGeometryInfoKHR buildInfo{};
+			buildInfo.setType(vk::AccelerationStructureTypeKHR::eTopLevel);
+			buildInfo.setFlags(
+				vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+				vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate);
+			buildInfo.setGeometries(ias);
+
+			if (buildType == TLAS_BUILD_FULL) {
+				vk::AccelerationStructureBuildSizesInfoKHR buildSizes =
+					device.getAccelerationStructureBuildSizesKHR(
+						vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo,
+						instanceCount);
+
+				TLAS.Create(physicalDevice, device,
+					vk::AccelerationStructureTypeKHR::eTopLevel,
+					buildSizes.accelerationStructureSize);
+
+				// Sub-allocated buffers only honour the memory alignment, the scratch address is aligned by hand
+				auto asProperties = vkutils::getAccelerationStructureProps(physicalDevice);
+				scratchAlignment = std::max<vk::DeviceSize>(asProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+				tlasScratchBuffer.Init(physicalDevice, device,
+					std::max(buildSizes.buildScratchSize, buildSizes.updateScratchSize) + scratchAlignment,
+					vk::BufferUsageFlagBits::eStorageBuffer |
+					vk::BufferUsageFlagBits::eShaderDeviceAddress,
+					vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+				buildInfo.setMode(vk::BuildAccelerationStructureModeKHR::eBuild);
+			}
+			else {
+				buildInfo.setMode(vk::BuildAccelerationStructureModeKHR::eUpdate);
+				buildInfo.setSrcAccelerationStructure(*TLAS.accel);
+			}
+
+			buildInfo.setDstAccelerationStructure(*TLAS.accel);
+			buildInfo.setScratchData(AlignScratch(tlasScratchBuffer.address));
+
+			vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
+			buildRangeInfo.setPrimitiveCount(instanceCount);
+			buildRangeInfo.setPrimitiveOffset(0);
+			buildRangeInfo.setFirstVertex(0);
+			buildRangeInfo.setTransformOffset(0);
 
+			vkutils::oneTimeSubmit(
+				device, commandPool, queue,
+				[&](vk::CommandBuffer commandBuffer) {
+					commandBuffer.buildAccelerationStructuresKHR(buildInfo, &buildRangeInfo);
+				});
+
+			if (buildType == TLAS_BUILD_FULL) {
+				TLAS.UpdateAddress(device);
+			}
+
+			bufferManager.ClearInstanceChanges();
+			tlasBuilt = true;
+			tlasNeedsRefit = false;
+		}
+
+		// BuildTLAS would write the TLAS, frames in flight tracing it have to be waited first
+		bool IsTLASOutdated(SceneBufferaManager& bufferManager) {
+			return GetTLASBuildType(bufferManager) != TLAS_BUILD_NONE;
 		}
 
 		void ReleaseTLAS(vk::Device device) {
 			TLAS.Release(device);
+			tlasInstanceBuffer.Release(device);
+			tlasScratchBuffer.Release(device);
+
+			tlasInstanceMap = nullptr;
+			tlasBuilt = false;
 		}
 
 		void ReleaseBLAS(vk::Device device) {
 			for (auto& blas : BLASes) {
 				blas.Release(device);
 			}
+			blasUpdateScratchBuffer.Release(device);
+			blasUpdateStates.clear();
+		}
+
+	private:
+		struct BLASUpdateState {
+			bool updatable = false;
+			uint32_t refitCount = 0;
+			float buildArea = 0.0f;
+
+			// Range in blasUpdateScratchBuffer, large enough for both update and build
+			vk::DeviceSize scratchOffset = 0;
+		};
+
+		vk::AccelerationStructureGeometryKHR GetBLASGeometry(SceneBufferaManager& bufferManager, uint32_t index) {
+			auto& geom = bufferManager.geometryOffset[index];
+			vk::AccelerationStructureGeometryTrianglesDataKHR triangles{};
+			triangles.setVertexFormat(vk::Format::eR32G32B32Sfloat);
+			triangles.setVertexData(bufferManager.positionBuffer.GetDeviceAddress() + geom.positionOffsetByte);
+			triangles.setVertexStride(sizeof(float) * 3);
+			triangles.setMaxVertex(geom.numVert);
+			triangles.setIndexType(geom.indexType);
+			triangles.setIndexData(bufferManager.indexBuffer.GetDeviceAddress() + geom.indexOffsetByte);
+
+			vk::AccelerationStructureGeometryKHR geometry{};
+			geometry.setGeometryType(vk::GeometryTypeKHR::eTriangles);
+			geometry.setGeometry({ triangles });
+			geometry.setFlags(vk::GeometryFlagBitsKHR::eOpaque);
+			return geometry;
+		}
+
+		vk::AccelerationStructureBuildRangeInfoKHR GetBLASBuildRange(SceneBufferaManager& bufferManager, uint32_t index) {
+			vk::AccelerationStructureBuildRangeInfoKHR buildRange{};
+			buildRange.setPrimitiveCount(bufferManager.geometryOffset[index].numIndex / 3);
+			buildRange.setPrimitiveOffset(0);
+			buildRange.setFirstVertex(0);
+			buildRange.setTransformOffset(0);
+			return buildRange;
+		}
+
+		// Update and build of a BLAS must use the same flags
+		vk::BuildAccelerationStructureFlagsKHR GetBLASBuildFlags(bool updatable) {
+			if (updatable) {
+				return vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+					vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate;
+			}
+			return vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+				vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+		}
+
+		vk::DeviceSize AlignScratch(vk::DeviceSize size) {
+			return (size + scratchAlignment - 1) / scratchAlignment * scratchAlignment;
+		}
+
+		// Surface area of the bounding box, used to detect loose refits
+		static float GetBoundsArea(const Geometry& geometry) {
+			if (geometry.m_vertices.empty()) return 0.0f;
+
+			vec3 minPos(std::numeric_limits<float>::max());
+			vec3 maxPos(-std::numeric_limits<float>::max());
+			for (auto& vert : geometry.m_vertices) {
+				minPos = vec3(std::min(minPos.x, vert.position.x), std::min(minPos.y, vert.position.y), std::min(minPos.z, vert.position.z));
+				maxPos = vec3(std::max(maxPos.x, vert.position.x), std::max(maxPos.y, vert.position.y), std::max(maxPos.z, vert.position.z));
+			}
+
+			vec3 size = maxPos - minPos;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
 		}
 
+		enum TLASBuildType {
+			TLAS_BUILD_NONE,
+			TLAS_BUILD_UPDATE,
+			TLAS_BUILD_FULL,
+		};
+
+		vk::AccelerationStructureInstanceKHR GetTLASInstance(SceneBufferaManager& bufferManager, uint32_t index) {
+			auto& inst = bufferManager.instanceData[index];
+			vk::AccelerationStructureInstanceKHR accel{};
+			accel.setTransform(inst.transform);
+			accel.setInstanceCustomIndex(index);
+			accel.setMask(0xff);
+			accel.setInstanceShaderBindingTableRecordOffset(0);
+			accel.setFlags(vk::GeometryInstanceFlagBitsKHR::eTriangleCullDisable);
+			accel.setAccelerationStructureReference(BLASes[inst.geometryIndex].buffer.address);
+			return accel;
+		}
+
+		// BLASes are only replaced by BuildBLAS, which resets tlasBuilt, so moved instances keep their BLAS
+		TLASBuildType GetTLASBuildType(SceneBufferaManager& bufferManager) {
+			if (!tlasBuilt || bufferManager.instanceSetChanged) return TLAS_BUILD_FULL;
+			return (!bufferManager.movedInstances.empty() || tlasNeedsRefit) ? TLAS_BUILD_UPDATE : TLAS_BUILD_NONE;
+		}
+
+		Buffer tlasInstanceBuffer;
+		Buffer tlasScratchBuffer;
+		vk::AccelerationStructureInstanceKHR* tlasInstanceMap = nullptr;
+		bool tlasBuilt = false;
+		bool tlasNeedsRefit = false;
+
+		std::vector<BLASUpdateState> blasUpdateStates;
+		Buffer blasUpdateScratchBuffer;
+		vk::DeviceSize scratchAlignment = 1;
+
+	public:
 		std::vector<AccelStruct> BLASes;
 		AccelStruct TLAS;
 
+		// Scratch budget of one BLAS build submit
+		static constexpr vk::DeviceSize MAX_BLAS_SCRATCH_SIZE = 256ull * 1024 * 1024;
+
+		// Refit policy of animated BLASes
+		static constexpr uint32_t MAX_BLAS_REFIT_COUNT = 64;
+		static constexpr float BLAS_REFIT_AREA_RATIO = 1.5f;
+
 	};
 
 
@@ -376,15 +1037,14 @@ namespace Skhole {
 		UniformBuffer() {};
 		~UniformBuffer() {};
 
-		void Init(vk::PhysicalDevice physicalDevice, vk::Device device) {
-
+		// numFrame : one slice per frame in flight, bound as eUniformBufferDynamic with GetOffset(frameIndex)
+		void Init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t numFrame = 1) {
 			buffer.Init(
 				physicalDevice, device,
 				sizeof(T),
 				vk::BufferUsageFlagBits::eUniformBuffer,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+				numFrame
 			);
-
 		}
 
 		vk::Buffer GetBuffer() {
@@ -392,13 +1052,15 @@ namespace Skhole {
 		}
 
 		size_t GetBufferSize() {
-			return buffer.bufferSize;
+			return sizeof(T);
 		}
 
-		void Update(vk::Device device) {
-			void* map = buffer.Map(device, 0, sizeof(T));
-			memcpy(map, &data, sizeof(T));
-			buffer.Unmap(device);
+		uint32_t GetOffset(uint32_t frameIndex) {
+			return buffer.GetOffset(frameIndex);
+		}
+
+		void Update(vk::Device device, uint32_t frameIndex = 0) {
+			memcpy(buffer.GetSlice(frameIndex), &data, sizeof(T));
 		}
 
 		void Release(vk::Device device) {
@@ -406,7 +1068,7 @@ namespace Skhole {
 		}
 
 		T data;
-		Buffer buffer;
+		FrameRingBuffer buffer;
 	};
 
 	template <typename T>
@@ -438,23 +1100,28 @@ namespace Skhole {
 			}
 		}
 
-		void UpdateBuffer(vk::Device device, vk::CommandPool commandPool, vk::Queue queue)
+		void UpdateBuffer(vk::Device device, UploadManager& uploadManager)
 		{
+			uploadManager.Wait(device, uploadValue);
+
 			void* map = buffer.Map(device, 0, sizeof(T) * materials.size());
 			memcpy(map, materials.data(), materials.size() * sizeof(T));
 			buffer.Unmap(device);
 
-			buffer.UploadToDevice(device, commandPool, queue);
+			uploadValue = uploadManager.Enqueue(buffer);
 		}
 
-		void UpdateBufferIndex(int index, vk::Device device, vk::CommandPool commandPool, vk::Queue queue) {
+		void UpdateBufferIndex(int index, vk::Device device, UploadManager& uploadManager) {
 			size_t byteOffset = index * sizeof(T);
 
+			// Edits before the next flush are merged into one copy
+			uploadManager.Wait(device, uploadValue);
+
 			void* map = buffer.Map(device, byteOffset, sizeof(T));
 			memcpy(map, materials.data() + index, sizeof(T));
 			buffer.Unmap(device);
 
-			buffer.UploadToDevice(device, commandPool, queue, byteOffset, sizeof(T));
+			uploadValue = uploadManager.Enqueue(buffer, byteOffset, sizeof(T));
 		}
 
 		vk::Buffer GetBuffer()
@@ -471,11 +1138,13 @@ namespace Skhole {
 		{
 			materials.clear();
 			buffer.Release(device);
+			uploadValue = 0;
 		}
 
 	private:
 		std::vector<T> materials;
 		DeviceBuffer buffer;
+		uint64_t uploadValue = 0;
 	};
 }
 
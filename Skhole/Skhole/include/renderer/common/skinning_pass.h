@@ -0,0 +1,288 @@
+#pragma once
+#include <include.h>
+#include <scene/scene.h>
+#include <scene/object/skin.h>
+#include <common/parallel.h>
+#include <renderer/common/buffer_manager.h>
+#include <vulkan_helpler/vk_buffer.h>
+#include <vulkan_helpler/vk_hepler.h>
+#include <vulkan_helpler/vkutils.hpp>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Skinning Pass
+	//-----------------------------------------------------
+	// Skinned geometries are posed by one compute dispatch per frame.
+	// Joint matrices are evaluated on the CPU, the shader writes positions and normals into
+	// the vertex ranges of SceneBufferaManager, then the BLASes are refit by ASManager::UpdateBLAS.
+	class SkinningPass {
+	public:
+		SkinningPass() {};
+		~SkinningPass() {};
+
+		// Bind pose, same layout as SkinVertex in skinning.comp
+		struct SkinVertexData {
+			float position[3];
+			uint32_t joints01;
+			float normal[3];
+			uint32_t joints23;
+			float weights[4];
+		};
+
+		// One skinned geometry, vertices [firstVertex, firstVertex + vertexCount) of skinVertexBuffer
+		struct SkinJob {
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t dstVertex;
+			uint32_t normalOffset;
+			uint32_t jointOffset;
+		};
+
+		struct PushConstant {
+			uint32_t numVertex;
+			uint32_t numJob;
+			uint32_t vertexFormat;
+		};
+
+		// Call after SceneBufferaManager::InitGeometryBuffer
+		void Init(SceneBufferaManager& bufferManager, vk::PhysicalDevice physicalDevice, vk::Device device, UploadManager& uploadManager) {
+			auto& scene = bufferManager.scene;
+			auto& geometries = scene->m_geometies;
+
+			std::vector<SkinJob> jobs;
+			uint32_t numVertex = 0;
+			uint32_t numJoint = 0;
+
+			for (uint32_t geomIndex = 0; geomIndex < geometries.size(); geomIndex++) {
+				auto& geometry = geometries[geomIndex];
+				if (!geometry->skinIndex.has_value()) continue;
+
+				if (geometry->skinIndex.value() >= scene->m_skins.size() ||
+					geometry->skinObjectIndex >= scene->m_objects.size() ||
+					geometry->m_skinVertices.size() != geometry->m_vertices.size()) {
+					SKHOLE_WARN("Invalid skin of geometry " << geomIndex << ", it is not posed");
+					continue;
+				}
+
+				auto& skin = scene->m_skins[geometry->skinIndex.value()];
+				if (skin->jointObjects.empty()) continue;
+
+				const auto& geomData = bufferManager.geometryData[geomIndex];
+
+				SkinJob job;
+				job.firstVertex = numVertex;
+				job.vertexCount = (uint32_t)geometry->m_vertices.size();
+				job.dstVertex = geomData.vertexOffset;
+				job.normalOffset = geomData.attributeOffsets[VERTEX_ATTRIBUTE_NORMAL];
+				job.jointOffset = numJoint;
+				jobs.push_back(job);
+
+				skinnedGeometries.push_back(geomIndex);
+
+				numVertex += job.vertexCount;
+				numJoint += (uint32_t)skin->jointObjects.size();
+			}
+
+			if (jobs.empty()) return;
+
+			this->numVertex = numVertex;
+			this->numJoint = numJoint;
+			this->numJob = (uint32_t)jobs.size();
+			vertexFormat = bufferManager.vertexFormat;
+
+			vk::BufferUsageFlags storageBufferUsage{
+				vk::BufferUsageFlagBits::eStorageBuffer
+			};
+
+			vk::MemoryPropertyFlags memoryProperty{
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+			};
+
+			skinVertexBuffer.Init(physicalDevice, device, numVertex * sizeof(SkinVertexData), storageBufferUsage, memoryProperty);
+			skinJobBuffer.Init(physicalDevice, device, numJob * sizeof(SkinJob), storageBufferUsage, memoryProperty);
+			jointBuffer.Init(physicalDevice, device, numJoint * sizeof(JointMatrix), storageBufferUsage, memoryProperty);
+
+			SkinVertexData* skinVertexMap = static_cast<SkinVertexData*>(skinVertexBuffer.Map(device, 0, skinVertexBuffer.GetBufferSize()));
+			for (size_t j = 0; j < jobs.size(); j++) {
+				const auto& job = jobs[j];
+				const auto& geometry = geometries[skinnedGeometries[j]];
+				const uint16_t maxJoint = (uint16_t)(scene->m_skins[geometry->skinIndex.value()]->jointObjects.size() - 1);
+
+				ParallelForChunk(job.vertexCount, 1 << 14, [&](size_t, size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++) {
+						const auto& vert = geometry->m_vertices[i];
+						const auto& skinVert = geometry->m_skinVertices[i];
+						auto& dst = skinVertexMap[job.firstVertex + i];
+
+						dst.position[0] = vert.position.x;
+						dst.position[1] = vert.position.y;
+						dst.position[2] = vert.position.z;
+						dst.normal[0] = vert.normal.x;
+						dst.normal[1] = vert.normal.y;
+						dst.normal[2] = vert.normal.z;
+
+						// Out of range joints would read other skins
+						uint32_t joints[4];
+						for (int c = 0; c < 4; c++) {
+							joints[c] = std::min(skinVert.joints[c], maxJoint);
+							dst.weights[c] = skinVert.weights[c];
+						}
+						dst.joints01 = joints[0] | (joints[1] << 16);
+						dst.joints23 = joints[2] | (joints[3] << 16);
+					}
+					});
+			}
+			skinVertexBuffer.Unmap(device);
+
+			void* jobMap = skinJobBuffer.Map(device, 0, skinJobBuffer.GetBufferSize());
+			memcpy(jobMap, jobs.data(), jobs.size() * sizeof(SkinJob));
+			skinJobBuffer.Unmap(device);
+
+			uploadManager.Enqueue(skinVertexBuffer);
+			uploadManager.Enqueue(skinJobBuffer);
+
+			InitPipeline(bufferManager, device);
+
+			SKHOLE_LOG("Skinning : " << numJob << " geometries, " << numVertex << " vertices, " << numJoint << " joints");
+			initialized = true;
+		}
+
+		// Poses the skinned geometries at time and appends their indices to updatedGeometries
+		void Execute(float time, SceneBufferaManager& bufferManager, vk::Device device, vk::CommandPool commandPool, vk::Queue queue, std::vector<uint32_t>& updatedGeometries) {
+			if (!initialized) return;
+
+			auto& scene = bufferManager.scene;
+
+			// Joint matrices
+			std::unordered_map<Object*, mat4> worldCache;
+			JointMatrix* jointMap = static_cast<JointMatrix*>(jointBuffer.Map(device, 0, jointBuffer.GetBufferSize()));
+			uint32_t jointOffset = 0;
+			for (auto geomIndex : skinnedGeometries) {
+				auto& geometry = scene->m_geometies[geomIndex];
+				auto& skin = scene->m_skins[geometry->skinIndex.value()];
+
+				EvaluateJointMatrices(*skin, scene->m_objects, geometry->skinObjectIndex, time, worldCache, jointMap + jointOffset);
+				jointOffset += (uint32_t)skin->jointObjects.size();
+			}
+			jointBuffer.Unmap(device);
+
+			PushConstant pushConstant;
+			pushConstant.numVertex = numVertex;
+			pushConstant.numJob = numJob;
+			pushConstant.vertexFormat = static_cast<uint32_t>(vertexFormat);
+
+			vkutils::oneTimeSubmit(device, commandPool, queue, [&](vk::CommandBuffer commandBuffer) {
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline);
+				commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 0, bindingManager.descriptorSet, nullptr);
+				commandBuffer.pushConstants(*pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant), &pushConstant);
+				commandBuffer.dispatch((numVertex + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+				// Positions feed the BLAS refit, normals the closest hit shader
+				vk::MemoryBarrier barrier{};
+				barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+				barrier.setDstAccessMask(vk::AccessFlagBits::eAccelerationStructureReadKHR | vk::AccessFlagBits::eShaderRead);
+				commandBuffer.pipelineBarrier(
+					vk::PipelineStageFlagBits::eComputeShader,
+					vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+					{}, barrier, {}, {});
+				});
+
+			for (auto geomIndex : skinnedGeometries) {
+				if (std::find(updatedGeometries.begin(), updatedGeometries.end(), geomIndex) == updatedGeometries.end()) {
+					updatedGeometries.push_back(geomIndex);
+				}
+			}
+		}
+
+		// Execute writes the shared vertex buffers every frame
+		bool IsActive() {
+			return initialized;
+		}
+
+		void Release(vk::Device device) {
+			if (initialized) {
+				skinVertexBuffer.Release(device);
+				skinJobBuffer.Release(device);
+				jointBuffer.Release(device);
+
+				bindingManager.Release(device);
+				computePipeline.reset();
+				pipelineLayout.reset();
+				csModule.reset();
+			}
+
+			skinnedGeometries.clear();
+			numVertex = 0;
+			numJoint = 0;
+			numJob = 0;
+			initialized = false;
+		}
+
+	private:
+		void InitPipeline(SceneBufferaManager& bufferManager, vk::Device device) {
+			csModule = vkutils::createShaderModule(device, "shader/skinning/skinning.comp.spv");
+
+			std::vector<VkHelper::BindingLayoutElement> bindingLayout = {
+				{0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+				{1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+				{2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+				{3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+				{4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+			};
+			bindingManager.SetBindingLayout(device, bindingLayout, vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+
+			vk::PipelineShaderStageCreateInfo shaderStageInfo{};
+			shaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+			shaderStageInfo.setModule(*csModule);
+			shaderStageInfo.setPName("main");
+
+			vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant) };
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+			pipelineLayoutInfo.setSetLayouts(bindingManager.descriptorSetLayout);
+			pipelineLayoutInfo.setPushConstantRanges(pushConstantRange);
+			pipelineLayout = device.createPipelineLayoutUnique(pipelineLayoutInfo);
+
+			vk::ComputePipelineCreateInfo pipelineInfo{ {},shaderStageInfo,*pipelineLayout };
+			auto result = device.createComputePipelineUnique({}, pipelineInfo);
+			if (result.result != vk::Result::eSuccess) {
+				SKHOLE_ERROR("Failed to create skinning pipeline");
+			}
+			computePipeline = std::move(result.value);
+
+			// The buffers do not change until Release
+			bindingManager.StartWriting();
+			bindingManager.WriteBuffer(skinVertexBuffer.GetDeviceBuffer(), 0, skinVertexBuffer.GetBufferSize(),
+				vk::DescriptorType::eStorageBuffer, 0, 1, device);
+			bindingManager.WriteBuffer(skinJobBuffer.GetDeviceBuffer(), 0, skinJobBuffer.GetBufferSize(),
+				vk::DescriptorType::eStorageBuffer, 1, 1, device);
+			bindingManager.WriteBuffer(jointBuffer.GetBuffer(), 0, jointBuffer.GetBufferSize(),
+				vk::DescriptorType::eStorageBuffer, 2, 1, device);
+			bindingManager.WriteBuffer(bufferManager.positionBuffer.GetDeviceBuffer(), 0, bufferManager.positionBuffer.GetBufferSize(),
+				vk::DescriptorType::eStorageBuffer, 3, 1, device);
+			bindingManager.WriteBuffer(bufferManager.attributeBuffer.GetDeviceBuffer(), 0, bufferManager.attributeBuffer.GetBufferSize(),
+				vk::DescriptorType::eStorageBuffer, 4, 1, device);
+			bindingManager.EndWriting(device);
+		}
+
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+		bool initialized = false;
+
+		std::vector<uint32_t> skinnedGeometries;
+		uint32_t numVertex = 0;
+		uint32_t numJoint = 0;
+		uint32_t numJob = 0;
+		VertexFormat vertexFormat = VertexFormat::STANDARD;
+
+		DeviceBuffer skinVertexBuffer;
+		DeviceBuffer skinJobBuffer;
+		Buffer jointBuffer;
+
+		vk::UniqueShaderModule csModule;
+		vk::UniquePipelineLayout pipelineLayout;
+		vk::UniquePipeline computePipeline;
+		VkHelper::BindingManager bindingManager;
+	};
+}
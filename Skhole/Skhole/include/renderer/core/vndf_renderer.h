@@ -3,6 +3,7 @@
 #include <renderer/renderer.h>
 
 #include <renderer/common/buffer_manager.h>
+#include <renderer/common/skinning_pass.h>
 
 #include <vulkan_helpler/vkutils.hpp>
 #include <vulkan_helpler/vk_buffer.h>
@@ -167,10 +168,11 @@ namespace Skhole
 
 		void UpdateMaterialBuffer(uint32_t matId)
 		{
+			// The copy is flushed in FrameStart and runs after the frames in flight
 			auto material = ConvertMaterial(m_scene->m_materials[matId]);
 			m_materialBuffer.SetMaterial(material, matId);
 
-			m_materialBuffer.UpdateBufferIndex(matId, *m_context.device, *m_commandPool, m_context.queue);
+			m_materialBuffer.UpdateBufferIndex(matId, *m_context.device, m_uploadManager);
 		}
 
 		void InitializeBiniding() override {
@@ -178,23 +180,24 @@ namespace Skhole
 				{0, vk::DescriptorType::eAccelerationStructureKHR, 1, vk::ShaderStageFlagBits::eRaygenKHR},
 				{1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR},
 				{2, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR},
-				{3, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eRaygenKHR },
+				{3, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eRaygenKHR },
 				{4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
 				{5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
 				{6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
-				{7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
+				{7, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
 				{8, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
 				{9, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR},
 			};
 
-			m_bindingManager.SetBindingLayout(*m_context.device, bindingLayout, vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+			m_bindingManager.SetBindingLayout(*m_context.device, bindingLayout, vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, MAX_FRAMES_IN_FLIGHT);
 		}
 
-		void UpdateDescriptorSet(RenderImages& renderImages) {
+		void UpdateDescriptorSet(RenderImages& renderImages, uint32_t frameIndex) {
 			auto& accumImage = renderImages.GetAccumImage();
 			auto& renderImage = renderImages.GetRenderImage();
 			auto& posproIamge = renderImages.GetPostProcessedImage();
 
+			m_bindingManager.SetFrame(frameIndex);
 			m_bindingManager.StartWriting();
 
 			m_bindingManager.WriteAS(
@@ -213,11 +216,11 @@ namespace Skhole
 
 			m_bindingManager.WriteBuffer(
 				m_uniformBuffer.GetBuffer(), 0, m_uniformBuffer.GetBufferSize(),
-				vk::DescriptorType::eUniformBuffer, 3, 1, *m_context.device
+				vk::DescriptorType::eUniformBufferDynamic, 3, 1, *m_context.device
 			);
 
 			m_bindingManager.WriteBuffer(
-				m_sceneBufferManager.vertexBuffer.GetDeviceBuffer(), 0, m_sceneBufferManager.vertexBuffer.GetBufferSize(),
+				m_sceneBufferManager.attributeBuffer.GetDeviceBuffer(), 0, m_sceneBufferManager.attributeBuffer.GetBufferSize(),
 				vk::DescriptorType::eStorageBuffer, 4, 1, *m_context.device
 			);
 
@@ -232,8 +235,8 @@ namespace Skhole
 			);
 
 			m_bindingManager.WriteBuffer(
-				m_sceneBufferManager.instanceBuffer.GetDeviceBuffer(), 0, m_sceneBufferManager.instanceBuffer.GetBufferSize(),
-				vk::DescriptorType::eStorageBuffer, 7, 1, *m_context.device
+				m_sceneBufferManager.GetInstanceBuffer().GetBuffer(), 0, m_sceneBufferManager.GetInstanceBuffer().GetRange(),
+				vk::DescriptorType::eStorageBufferDynamic, 7, 1, *m_context.device
 			);
 
 			m_bindingManager.WriteBuffer(
@@ -242,10 +245,12 @@ namespace Skhole
 			);
 
 			m_bindingManager.WriteBuffer(
-				m_sceneBufferManager.matIndexBuffer.GetDeviceBuffer(), 0, m_sceneBufferManager.matIndexBuffer.GetBufferSize(),
+				m_sceneBufferManager.materialRangeBuffer.GetDeviceBuffer(), 0, m_sceneBufferManager.materialRangeBuffer.GetBufferSize(),
 				vk::DescriptorType::eStorageBuffer, 9, 1, *m_context.device
 			);
 
+			// Binding 3 and 7, in binding order
+			m_dynamicOffsets = { m_uniformBuffer.GetOffset(frameIndex), m_sceneBufferManager.GetInstanceBuffer().GetOffset(frameIndex) };
 
 			m_bindingManager.EndWriting(*m_context.device);
 		}
@@ -279,10 +284,14 @@ namespace Skhole
 			// For GLSL
 			VK_KHR_RELAXED_BLOCK_LAYOUT_EXTENSION_NAME,
 			VK_EXT_SCALAR_BLOCK_LAYOUT_EXTENSION_NAME,
+
+			// For upload
+			VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
 		};
 
 		SceneBufferaManager m_sceneBufferManager;
 		ASManager m_asManager;
+		SkinningPass m_skinningPass;
 
 		MaterialBuffer<Material> m_materialBuffer;
 		UniformBuffer<Uniform> m_uniformBuffer;
@@ -6,6 +6,7 @@
 #include <renderer/common/raytracing_pipeline.h>
 #include <vulkan_helpler/vk_hepler.h>
 #include <vulkan_helpler/vk_imgui.h>
+#include <vulkan_helpler/vk_upload.h>
 #include <post_process/post_processor.h>
 #include <post_process/post_processor_interface.h>
 #include <common/util.h>
@@ -190,9 +191,18 @@ namespace Skhole
 		};
 		virtual ShaderPaths GetShaderPaths() = 0;
 
+		// Frames in flight of RealTimeRender
+		// WaitFrame -> (record m_frames[m_frameIndex].commandBuffer) -> AcquireFrame -> SubmitFrame
+		void InitFrameResources();
+		void ReleaseFrameResources();
+		void WaitFrame();
+		void WaitFrames();
+		uint32_t AcquireFrame();
+		void SubmitFrame(uint32_t imageIndex);
+
 		// Rendering Commands
 		void RaytracingCommand(const vk::CommandBuffer& commandBuffer, uint32_t width, uint32_t height);
-		void RecordCommandBuffer(uint32_t width, uint32_t height);
+		void RecordCommandBuffer(const vk::CommandBuffer& commandBuffer, uint32_t width, uint32_t height);
 		void CopyRenderToScreen(const vk::CommandBuffer& commandBuffer, vk::Image src, vk::Image screen, uint32_t width, uint32_t height);
 		void RenderImGuiCommand(const vk::CommandBuffer& commandBuffer, vk::Framebuffer frameBuffer, uint32_t width, uint32_t height);
 
@@ -207,11 +217,27 @@ namespace Skhole
 		vk::UniqueCommandPool m_commandPool;
 		vk::UniqueCommandBuffer m_commandBuffer;
 
+		// Staging copies of scene buffers, flushed once per frame
+		UploadManager m_uploadManager;
+
+		static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+		struct FrameResource {
+			vk::UniqueCommandBuffer commandBuffer;
+			vk::UniqueFence fence; // Signaled when the GPU finished the frame
+			vk::UniqueSemaphore imageAvailableSemaphore;
+		};
+
+		std::array<FrameResource, MAX_FRAMES_IN_FLIGHT> m_frames;
+		std::vector<vk::UniqueSemaphore> m_renderFinishedSemaphores; // Per swapchain image
+		uint32_t m_frameIndex = 0;
+
 		VkHelper::VulkanImGuiManager m_imGuiManager;
 		vk::UniqueRenderPass m_imGuiRenderPass;
 
 		RaytracingPipeline m_raytracingPipeline;
 		VkHelper::BindingManager m_bindingManager;
+		std::vector<uint32_t> m_dynamicOffsets; // Set by UpdateDescriptorSet for the dynamic bindings
 
 		RenderImages m_renderImages;
 
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <include.h>
+#include <common/log.h>
+#include <scene/object/geometry.h>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Binary Geometry Container
+	//-----------------------------------------------------
+	// [Header][Entry * numGeometry][Blob][Blob]...
+	// Every blob is a raw copy of the Geometry arrays and starts on a
+	// SKGEOM_BLOB_ALIGNMENT boundary, so it can be read in place from a mapped view.
+
+	constexpr uint32_t SKGEOM_MAGIC = 0x4D454753; // "SGEM"
+	constexpr uint32_t SKGEOM_VERSION = 1;
+	constexpr uint64_t SKGEOM_BLOB_ALIGNMENT = 64;
+
+	enum GeometryContainerFlag : uint32_t {
+		SKGEOM_FLAG_ANIMATION = 1 << 0,
+		SKGEOM_FLAG_CONNECT_INDEX = 1 << 1,
+	};
+
+	struct GeometryContainerHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t numGeometry;
+		uint32_t vertexStride; // sizeof(VertexData) when written
+		uint64_t entryOffset;
+		uint64_t totalSize;
+	};
+
+	struct GeometryContainerBlob {
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	struct GeometryContainerEntry {
+		GeometryContainerBlob vertices;
+		GeometryContainerBlob indices;
+		GeometryContainerBlob materialIndices;
+		GeometryContainerBlob connectPrimId;
+		uint32_t flags;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(GeometryContainerHeader) == 32, "GeometryContainerHeader layout changed");
+	static_assert(sizeof(GeometryContainerEntry) == 72, "GeometryContainerEntry layout changed");
+
+	inline uint64_t AlignContainerOffset(uint64_t offset) {
+		return (offset + SKGEOM_BLOB_ALIGNMENT - 1) & ~(SKGEOM_BLOB_ALIGNMENT - 1);
+	}
+
+	inline bool WriteGeometryContainer(std::ostream& os, const std::vector<ShrPtr<Geometry>>& geoms)
+	{
+		// Layout
+		std::vector<GeometryContainerEntry> entries(geoms.size());
+
+		uint64_t offset = sizeof(GeometryContainerHeader);
+		uint64_t entryOffset = offset;
+		offset += sizeof(GeometryContainerEntry) * entries.size();
+
+		auto placeBlob = [&offset](GeometryContainerBlob& blob, size_t count, size_t stride) {
+			offset = AlignContainerOffset(offset);
+			blob.offset = offset;
+			blob.count = count;
+			offset += count * stride;
+			};
+
+		for (size_t i = 0; i < geoms.size(); i++) {
+			auto& geom = geoms[i];
+			auto& entry = entries[i];
+			placeBlob(entry.vertices, geom->m_vertices.size(), sizeof(VertexData));
+			placeBlob(entry.indices, geom->m_indices.size(), sizeof(uint32_t));
+			placeBlob(entry.materialIndices, geom->m_materialIndices.size(), sizeof(uint32_t));
+			placeBlob(entry.connectPrimId, geom->m_connectPrimId.size(), sizeof(uint32_t));
+
+			entry.flags = 0;
+			if (geom->useAnimation) entry.flags |= SKGEOM_FLAG_ANIMATION;
+			if (geom->useConnectIndex) entry.flags |= SKGEOM_FLAG_CONNECT_INDEX;
+			entry.reserved = 0;
+		}
+
+		GeometryContainerHeader header{};
+		header.magic = SKGEOM_MAGIC;
+		header.version = SKGEOM_VERSION;
+		header.numGeometry = static_cast<uint32_t>(geoms.size());
+		header.vertexStride = sizeof(VertexData);
+		header.entryOffset = entryOffset;
+		header.totalSize = AlignContainerOffset(offset);
+
+		// Write
+		uint64_t written = 0;
+		auto writeBytes = [&os, &written](const void* data, uint64_t size) {
+			if (size == 0) return;
+			os.write(reinterpret_cast<const char*>(data), size);
+			written += size;
+			};
+		auto padTo = [&os, &written](uint64_t target) {
+			static const char zero[SKGEOM_BLOB_ALIGNMENT] = {};
+			while (written < target) {
+				uint64_t size = std::min<uint64_t>(target - written, SKGEOM_BLOB_ALIGNMENT);
+				os.write(zero, size);
+				written += size;
+			}
+			};
+
+		writeBytes(&header, sizeof(header));
+		writeBytes(entries.data(), sizeof(GeometryContainerEntry) * entries.size());
+
+		for (size_t i = 0; i < geoms.size(); i++) {
+			auto& geom = geoms[i];
+			auto& entry = entries[i];
+
+			padTo(entry.vertices.offset);
+			writeBytes(geom->m_vertices.data(), entry.vertices.count * sizeof(VertexData));
+			padTo(entry.indices.offset);
+			writeBytes(geom->m_indices.data(), entry.indices.count * sizeof(uint32_t));
+			padTo(entry.materialIndices.offset);
+			writeBytes(geom->m_materialIndices.data(), entry.materialIndices.count * sizeof(uint32_t));
+			padTo(entry.connectPrimId.offset);
+			writeBytes(geom->m_connectPrimId.data(), entry.connectPrimId.count * sizeof(uint32_t));
+		}
+		padTo(header.totalSize);
+
+		return os.good();
+	}
+
+	template <typename T>
+	inline bool ReadContainerBlob(const uint8_t* data, size_t size, const GeometryContainerBlob& blob, std::vector<T>& dst)
+	{
+		if (blob.offset > size || blob.count > (size - blob.offset) / sizeof(T)) {
+			SKHOLE_ERROR("Geometry container blob is out of range");
+			return false;
+		}
+		const T* src = reinterpret_cast<const T*>(data + blob.offset);
+		dst.assign(src, src + blob.count);
+		return true;
+	}
+
+	inline bool ReadGeometryContainer(const uint8_t* data, size_t size, std::vector<ShrPtr<Geometry>>& geoms)
+	{
+		if (size < sizeof(GeometryContainerHeader)) {
+			SKHOLE_ERROR("Geometry container is too small");
+			return false;
+		}
+
+		GeometryContainerHeader header;
+		memcpy(&header, data, sizeof(header));
+
+		if (header.magic != SKGEOM_MAGIC) {
+			SKHOLE_ERROR("Invalid geometry container");
+			return false;
+		}
+		if (header.version != SKGEOM_VERSION || header.vertexStride != sizeof(VertexData)) {
+			SKHOLE_ERROR("Unsupported geometry container version");
+			return false;
+		}
+		if (header.totalSize > size || header.entryOffset + sizeof(GeometryContainerEntry) * (uint64_t)header.numGeometry > size) {
+			SKHOLE_ERROR("Geometry container is truncated");
+			return false;
+		}
+
+		std::vector<GeometryContainerEntry> entries(header.numGeometry);
+		memcpy(entries.data(), data + header.entryOffset, sizeof(GeometryContainerEntry) * entries.size());
+
+		geoms.reserve(geoms.size() + entries.size());
+		for (auto& entry : entries) {
+			ShrPtr<Geometry> geom = MakeShr<Geometry>();
+
+			if (!ReadContainerBlob(data, size, entry.vertices, geom->m_vertices)) return false;
+			if (!ReadContainerBlob(data, size, entry.indices, geom->m_indices)) return false;
+			if (!ReadContainerBlob(data, size, entry.materialIndices, geom->m_materialIndices)) return false;
+			if (!ReadContainerBlob(data, size, entry.connectPrimId, geom->m_connectPrimId)) return false;
+
+			geom->useAnimation = (entry.flags & SKGEOM_FLAG_ANIMATION) != 0;
+			geom->useConnectIndex = (entry.flags & SKGEOM_FLAG_CONNECT_INDEX) != 0;
+
+			geoms.push_back(geom);
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <include.h>
+#include <common/log.h>
+#include <common/hash.h>
+#include <common/parallel.h>
+#include <scene/scene.h>
+
+#include <unordered_map>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Geometry Deduplication
+	//-----------------------------------------------------
+	// Byte-identical geometries are collapsed into one, instances are pointed at the kept geometry
+	// so they share the vertex range and the BLAS. Animated geometries are never merged.
+
+	struct GeometryDedupStats {
+		uint32_t numGeometry = 0;
+		uint32_t numRemoved = 0;
+		uint64_t savedBytes = 0;
+	};
+
+	inline uint64_t HashGeometry(const Geometry& geom) {
+		uint64_t hash = HashBytes(geom.m_vertices.data(), geom.m_vertices.size() * sizeof(VertexData));
+		hash = HashCombine(hash, HashBytes(geom.m_indices.data(), geom.m_indices.size() * sizeof(uint32_t)));
+		hash = HashCombine(hash, HashBytes(geom.m_materialIndices.data(), geom.m_materialIndices.size() * sizeof(uint32_t)));
+		return hash;
+	}
+
+	inline bool IsSameGeometry(const Geometry& a, const Geometry& b) {
+		auto sameBytes = [](const auto& x, const auto& y) {
+			return x.size() == y.size() && (x.empty() || memcmp(x.data(), y.data(), x.size() * sizeof(x[0])) == 0);
+			};
+
+		return sameBytes(a.m_vertices, b.m_vertices) &&
+			sameBytes(a.m_indices, b.m_indices) &&
+			sameBytes(a.m_materialIndices, b.m_materialIndices);
+	}
+
+	inline uint64_t GetGeometryByteSize(const Geometry& geom) {
+		return geom.m_vertices.size() * sizeof(VertexData) +
+			(geom.m_indices.size() + geom.m_materialIndices.size() + geom.m_connectPrimId.size()) * sizeof(uint32_t);
+	}
+
+	inline GeometryDedupStats DeduplicateGeometries(Scene& scene) {
+		auto& geometries = scene.m_geometies;
+
+		GeometryDedupStats stats;
+		stats.numGeometry = (uint32_t)geometries.size();
+
+		std::vector<uint64_t> hashes(geometries.size());
+		ParallelForDynamic(geometries.size(), [&](size_t i) {
+			hashes[i] = HashGeometry(*geometries[i]);
+			});
+
+		// Old geometry index -> new geometry index
+		std::vector<uint32_t> remap(geometries.size());
+		std::vector<ShrPtr<Geometry>> uniqueGeometries;
+		std::unordered_map<uint64_t, std::vector<uint32_t>> candidates;
+
+		for (size_t i = 0; i < geometries.size(); i++) {
+			auto& geometry = geometries[i];
+
+			if (!geometry->useAnimation) {
+				auto& sameHash = candidates[hashes[i]];
+
+				auto found = std::find_if(sameHash.begin(), sameHash.end(), [&](uint32_t index) {
+					return IsSameGeometry(*uniqueGeometries[index], *geometry);
+					});
+
+				if (found != sameHash.end()) {
+					remap[i] = *found;
+					stats.numRemoved++;
+					stats.savedBytes += GetGeometryByteSize(*geometry);
+					continue;
+				}
+
+				sameHash.push_back((uint32_t)uniqueGeometries.size());
+			}
+
+			remap[i] = (uint32_t)uniqueGeometries.size();
+			uniqueGeometries.push_back(geometry);
+		}
+
+		if (stats.numRemoved == 0) return stats;
+
+		for (auto& object : scene.m_objects) {
+			if (object->GetObjectType() != ObjectType::INSTANCE) continue;
+
+			auto instance = std::static_pointer_cast<Instance>(object);
+			if (instance->geometryIndex.has_value() && instance->geometryIndex.value() < remap.size()) {
+				instance->geometryIndex = remap[instance->geometryIndex.value()];
+			}
+		}
+
+		geometries = std::move(uniqueGeometries);
+
+		SKHOLE_LOG("Deduplicate Geometry : " << stats.numGeometry << " -> " << geometries.size() << " geometries, "
+			<< stats.savedBytes / (1024.0 * 1024.0) << " MB saved");
+
+		return stats;
+	}
+}
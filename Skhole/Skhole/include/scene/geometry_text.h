@@ -0,0 +1,405 @@
+#pragma once
+
+#include <include.h>
+#include <common/log.h>
+#include <common/parallel.h>
+#include <common/timer.h>
+#include <scene/object/geometry.h>
+
+#include <charconv>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Text Geometry (.skgeom)
+	//-----------------------------------------------------
+	// Geometries
+	// <numGeometry>
+	//
+	// #Geom<index>
+	// #Vertices <numVertex>
+	// vp x y z w / vn x y z w / vt0 u v / vt1 u v / vc r g b a  (one line each per vertex)
+	// #Indices <numIndex>
+	// i i i ...
+	// #MaterialIndices <numMaterialIndex>
+	// i i i ...
+
+	// Same text as std::ostream << float with the default precision
+	inline void AppendTextFloat(std::string& str, float value) {
+		char buf[32];
+		auto result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+		str.append(buf, result.ptr);
+	}
+
+	template <typename T>
+	inline void AppendTextInt(std::string& str, T value) {
+		char buf[24];
+		auto result = std::to_chars(buf, buf + sizeof(buf), value);
+		str.append(buf, result.ptr);
+	}
+
+	// One piece of the output, formatted on its own
+	struct GeometryTextSegment {
+		enum Type {
+			TEXT,
+			VERTICES,
+			INDICES,
+			MATERIAL_INDICES,
+		};
+
+		Type type;
+		const Geometry* geom;
+		size_t begin;
+		size_t end;
+		std::string text;
+	};
+
+	inline void FormatGeometryTextSegment(GeometryTextSegment& segment) {
+		if (segment.type == GeometryTextSegment::TEXT) return;
+
+		auto& str = segment.text;
+		const size_t count = segment.end - segment.begin;
+
+		if (segment.type == GeometryTextSegment::VERTICES) {
+			str.reserve(count * 160);
+			auto appendValues = [&str](const char* prefix, const float* values, int numValue) {
+				str += prefix;
+				for (int i = 0; i < numValue; i++) {
+					str += ' ';
+					AppendTextFloat(str, values[i]);
+				}
+				str += '\n';
+				};
+
+			for (size_t i = segment.begin; i < segment.end; i++) {
+				const auto& vert = segment.geom->m_vertices[i];
+				const float position[4] = { vert.position.x, vert.position.y, vert.position.z, vert.position.w };
+				const float normal[4] = { vert.normal.x, vert.normal.y, vert.normal.z, vert.normal.w };
+				const float color[4] = { vert.color.x, vert.color.y, vert.color.z, vert.color.w };
+				appendValues("vp", position, 4);
+				appendValues("vn", normal, 4);
+				appendValues("vt0", vert.texcoord0, 2);
+				appendValues("vt1", vert.texcoord1, 2);
+				appendValues("vc", color, 4);
+			}
+		}
+		else {
+			const auto& indices = (segment.type == GeometryTextSegment::INDICES) ? segment.geom->m_indices : segment.geom->m_materialIndices;
+			str.reserve(count * 8);
+			for (size_t i = segment.begin; i < segment.end; i++) {
+				AppendTextInt(str, indices[i]);
+				str += ' ';
+			}
+		}
+	}
+
+	inline bool WriteGeometriesText(std::ostream& os, const std::vector<ShrPtr<Geometry>>& geoms)
+	{
+		constexpr size_t VERTEX_SEGMENT = 1 << 15;
+		constexpr size_t INDEX_SEGMENT = 1 << 18;
+
+		// Segments in file order
+		std::vector<GeometryTextSegment> segments;
+		auto addText = [&segments](std::string text) {
+			segments.push_back({ GeometryTextSegment::TEXT, nullptr, 0, 0, std::move(text) });
+			};
+		auto addRange = [&segments](GeometryTextSegment::Type type, const Geometry* geom, size_t count, size_t segmentSize) {
+			for (size_t begin = 0; begin < count; begin += segmentSize) {
+				segments.push_back({ type, geom, begin, std::min(begin + segmentSize, count), {} });
+			}
+			};
+
+		addText("Geometries\n" + std::to_string(geoms.size()) + "\n\n");
+
+		for (size_t index = 0; index < geoms.size(); index++) {
+			const auto& geometry = geoms[index];
+
+			addText("#Geom" + std::to_string(index) + "\n#Vertices " + std::to_string(geometry->m_vertices.size()) + "\n");
+			addRange(GeometryTextSegment::VERTICES, geometry.get(), geometry->m_vertices.size(), VERTEX_SEGMENT);
+
+			addText("#Indices " + std::to_string(geometry->m_indices.size()) + "\n");
+			addRange(GeometryTextSegment::INDICES, geometry.get(), geometry->m_indices.size(), INDEX_SEGMENT);
+
+			addText("\n#MaterialIndices " + std::to_string(geometry->m_materialIndices.size()) + "\n");
+			addRange(GeometryTextSegment::MATERIAL_INDICES, geometry.get(), geometry->m_materialIndices.size(), INDEX_SEGMENT);
+
+			addText("\n\n");
+		}
+
+		// Format a window of segments in parallel, then write it in order.
+		// The window keeps the formatted text in memory bounded.
+		const size_t window = GetWorkerCount() * 4;
+		for (size_t first = 0; first < segments.size(); first += window) {
+			size_t last = std::min(first + window, segments.size());
+
+			ParallelForDynamic(last - first, [&](size_t i) {
+				FormatGeometryTextSegment(segments[first + i]);
+				});
+
+			for (size_t i = first; i < last; i++) {
+				os.write(segments[i].text.data(), segments[i].text.size());
+				std::string().swap(segments[i].text);
+			}
+		}
+
+		return os.good();
+	}
+
+	//-----------------------------------------------------
+	// Text Geometry Reader
+	//-----------------------------------------------------
+	// Line starting '#' markers are collected in parallel, they give every block of the file.
+	// Blocks are split into record aligned pieces that are parsed concurrently with from_chars.
+
+	inline const char* SkipTextSpace(const char* p, const char* end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+		return p;
+	}
+
+	inline const char* SkipTextToken(const char* p, const char* end) {
+		p = SkipTextSpace(p, end);
+		while (p < end && !(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+		return p;
+	}
+
+	template <typename T>
+	inline bool ParseTextValue(const char*& p, const char* end, T& value) {
+		p = SkipTextSpace(p, end);
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc()) return false;
+		p = result.ptr;
+		return true;
+	}
+
+	struct GeometryTextBlock {
+		enum Type {
+			VERTICES,
+			INDICES,
+			MATERIAL_INDICES,
+		};
+
+		Type type;
+		uint32_t geomIndex;
+		size_t count;
+		const char* begin;
+		const char* end;
+	};
+
+	struct GeometryTextPiece {
+		size_t blockIndex;
+		const char* begin;
+		const char* end;
+		size_t offset; // first element in the block
+
+		std::vector<VertexData> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	inline bool ParseGeometryTextPiece(GeometryTextBlock::Type type, GeometryTextPiece& piece) {
+		const char* p = piece.begin;
+		const char* end = piece.end;
+
+		if (type == GeometryTextBlock::VERTICES) {
+			while (true) {
+				p = SkipTextSpace(p, end);
+				if (p >= end) break;
+
+				VertexData vert;
+				p = SkipTextToken(p, end);
+				bool ok = ParseTextValue(p, end, vert.position.v[0]) && ParseTextValue(p, end, vert.position.v[1])
+					&& ParseTextValue(p, end, vert.position.v[2]) && ParseTextValue(p, end, vert.position.v[3]);
+
+				p = SkipTextToken(p, end);
+				ok = ok && ParseTextValue(p, end, vert.normal.v[0]) && ParseTextValue(p, end, vert.normal.v[1])
+					&& ParseTextValue(p, end, vert.normal.v[2]) && ParseTextValue(p, end, vert.normal.v[3]);
+
+				p = SkipTextToken(p, end);
+				ok = ok && ParseTextValue(p, end, vert.texcoord0[0]) && ParseTextValue(p, end, vert.texcoord0[1]);
+
+				p = SkipTextToken(p, end);
+				ok = ok && ParseTextValue(p, end, vert.texcoord1[0]) && ParseTextValue(p, end, vert.texcoord1[1]);
+
+				p = SkipTextToken(p, end);
+				ok = ok && ParseTextValue(p, end, vert.color.v[0]) && ParseTextValue(p, end, vert.color.v[1])
+					&& ParseTextValue(p, end, vert.color.v[2]) && ParseTextValue(p, end, vert.color.v[3]);
+
+				if (!ok) return false;
+				piece.vertices.push_back(vert);
+			}
+		}
+		else {
+			while (true) {
+				p = SkipTextSpace(p, end);
+				if (p >= end) break;
+
+				uint32_t index;
+				if (!ParseTextValue(p, end, index)) return false;
+				piece.indices.push_back(index);
+			}
+		}
+
+		return true;
+	}
+
+	// Next record start at or after pos. Vertices start with a "vp" line, indices after a space.
+	inline const char* AlignGeometryTextPiece(GeometryTextBlock::Type type, const char* pos, const char* end) {
+		if (type == GeometryTextBlock::VERTICES) {
+			while (pos < end) {
+				const char* line = static_cast<const char*>(memchr(pos, '\n', end - pos));
+				if (!line) return end;
+				pos = line + 1;
+				if (end - pos >= 2 && pos[0] == 'v' && pos[1] == 'p') return pos;
+			}
+			return end;
+		}
+		else {
+			while (pos < end && *pos != ' ' && *pos != '\n') pos++;
+			return pos;
+		}
+	}
+
+	// Reads the "<name> <count>" line at a marker, returns the start of the next line
+	inline const char* ReadGeometryTextMarker(const char* marker, const char* end, const char* name, size_t& count) {
+		size_t length = strlen(name);
+		if (size_t(end - marker) < length || memcmp(marker, name, length) != 0) return nullptr;
+
+		const char* p = marker + length;
+		if (!ParseTextValue(p, end, count)) return nullptr;
+
+		const char* line = static_cast<const char*>(memchr(p, '\n', end - p));
+		return line ? line + 1 : end;
+	}
+
+	inline bool ReadGeometriesText(const char* data, size_t size, std::vector<ShrPtr<Geometry>>& geometry)
+	{
+		constexpr size_t PIECE_SIZE = 1 << 22;
+		const char* end = data + size;
+
+		// Header
+		const char* p = SkipTextSpace(data, end);
+		if (size_t(end - p) < 10 || memcmp(p, "Geometries", 10) != 0) return false;
+		p += 10;
+
+		size_t numGeom;
+		if (!ParseTextValue(p, end, numGeom)) return false;
+
+		// Markers
+		std::vector<std::vector<const char*>> chunkMarkers(GetParallelChunkCount(size, PIECE_SIZE));
+		ParallelForChunk(size, PIECE_SIZE, [&](size_t chunk, size_t begin, size_t chunkEnd) {
+			auto& markers = chunkMarkers[chunk];
+			const char* c = data + begin;
+			while (c < data + chunkEnd) {
+				c = static_cast<const char*>(memchr(c, '#', data + chunkEnd - c));
+				if (!c) break;
+				if (c == data || c[-1] == '\n') markers.push_back(c);
+				c++;
+			}
+			});
+
+		std::vector<const char*> markers;
+		for (auto& chunk : chunkMarkers) {
+			markers.insert(markers.end(), chunk.begin(), chunk.end());
+		}
+
+		if (markers.size() != numGeom * 4) {
+			SKHOLE_WARN("Geometry file is broken : " << markers.size() << " sections for " << numGeom << " geometries");
+			return false;
+		}
+
+		// Blocks
+		std::vector<GeometryTextBlock> blocks;
+		blocks.reserve(numGeom * 3);
+		for (size_t i = 0; i < numGeom; i++) {
+			const char* const* marker = &markers[i * 4];
+			const char* geomEnd = (i + 1 < numGeom) ? markers[(i + 1) * 4] : end;
+
+			size_t geomIndex;
+			size_t numVert, numIndex, numMatIndex;
+			const char* vertBegin = ReadGeometryTextMarker(marker[1], end, "#Vertices", numVert);
+			const char* indexBegin = ReadGeometryTextMarker(marker[2], end, "#Indices", numIndex);
+			const char* matBegin = ReadGeometryTextMarker(marker[3], end, "#MaterialIndices", numMatIndex);
+			if (!ReadGeometryTextMarker(marker[0], end, "#Geom", geomIndex) || !vertBegin || !indexBegin || !matBegin) {
+				SKHOLE_WARN("Geometry file is broken : #Geom" << i);
+				return false;
+			}
+
+			blocks.push_back({ GeometryTextBlock::VERTICES, uint32_t(i), numVert, vertBegin, marker[2] });
+			blocks.push_back({ GeometryTextBlock::INDICES, uint32_t(i), numIndex, indexBegin, marker[3] });
+			blocks.push_back({ GeometryTextBlock::MATERIAL_INDICES, uint32_t(i), numMatIndex, matBegin, geomEnd });
+		}
+
+		// Pieces
+		std::vector<GeometryTextPiece> pieces;
+		for (size_t i = 0; i < blocks.size(); i++) {
+			const auto& block = blocks[i];
+			const char* pieceBegin = block.begin;
+			while (pieceBegin < block.end) {
+				const char* pieceEnd = block.end;
+				if (size_t(block.end - pieceBegin) > PIECE_SIZE) {
+					pieceEnd = AlignGeometryTextPiece(block.type, pieceBegin + PIECE_SIZE, block.end);
+				}
+
+				GeometryTextPiece piece;
+				piece.blockIndex = i;
+				piece.begin = pieceBegin;
+				piece.end = pieceEnd;
+				piece.offset = 0;
+				pieces.push_back(std::move(piece));
+
+				pieceBegin = pieceEnd;
+			}
+		}
+
+		std::atomic<bool> failed = false;
+		ParallelForDynamic(pieces.size(), [&](size_t i) {
+			if (!ParseGeometryTextPiece(blocks[pieces[i].blockIndex].type, pieces[i])) failed = true;
+			});
+		if (failed) {
+			SKHOLE_WARN("Geometry file is broken : failed to parse a value");
+			return false;
+		}
+
+		// Counts
+		std::vector<size_t> blockCounts(blocks.size(), 0);
+		for (auto& piece : pieces) {
+			piece.offset = blockCounts[piece.blockIndex];
+			blockCounts[piece.blockIndex] += piece.vertices.size() + piece.indices.size();
+		}
+
+		for (size_t i = 0; i < blocks.size(); i++) {
+			if (blockCounts[i] != blocks[i].count) {
+				SKHOLE_WARN("Geometry file is broken : #Geom" << blocks[i].geomIndex << " has " << blockCounts[i] << " elements, expected " << blocks[i].count);
+				return false;
+			}
+		}
+
+		// Copy the pieces into the geometries
+		std::vector<ShrPtr<Geometry>> geoms(numGeom);
+		for (size_t i = 0; i < numGeom; i++) {
+			geoms[i] = MakeShr<Geometry>();
+			geoms[i]->m_vertices.resize(blocks[i * 3 + 0].count);
+			geoms[i]->m_indices.resize(blocks[i * 3 + 1].count);
+			geoms[i]->m_materialIndices.resize(blocks[i * 3 + 2].count);
+		}
+
+		ParallelForDynamic(pieces.size(), [&](size_t i) {
+			auto& piece = pieces[i];
+			const auto& block = blocks[piece.blockIndex];
+			auto& geom = geoms[block.geomIndex];
+
+			if (block.type == GeometryTextBlock::VERTICES) {
+				std::copy(piece.vertices.begin(), piece.vertices.end(), geom->m_vertices.begin() + piece.offset);
+			}
+			else {
+				auto& indices = (block.type == GeometryTextBlock::INDICES) ? geom->m_indices : geom->m_materialIndices;
+				std::copy(piece.indices.begin(), piece.indices.end(), indices.begin() + piece.offset);
+			}
+			std::vector<VertexData>().swap(piece.vertices);
+			std::vector<uint32_t>().swap(piece.indices);
+			});
+
+		geometry.insert(geometry.end(), geoms.begin(), geoms.end());
+
+		return true;
+	}
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include <include.h>
+#include <common/log.h>
+#include <common/timer.h>
+#include <common/parallel.h>
 
 using namespace VectorLikeGLSL;
 namespace Skhole {
@@ -12,6 +15,12 @@ namespace Skhole {
 		vec4 color;
 	};
 
+	// Up to 4 joints per vertex, indices into Skin::jointObjects
+	struct SkinVertex {
+		uint16_t joints[4];
+		float weights[4];
+	};
+
 	class Geometry {
 	public:
 		Geometry() {};
@@ -26,6 +35,14 @@ namespace Skhole {
 
 		bool useAnimation = false;
 
+		// Set after rewriting m_vertices of an animated geometry, cleared when the renderer uploads them
+		bool isVertexUpdated = false;
+
+		// Skinning : skin in Scene::m_skins, the object placing the geometry and the weights of m_vertices
+		std::optional<uint32_t> skinIndex;
+		uint32_t skinObjectIndex = 0;
+		std::vector<SkinVertex> m_skinVertices;
+
 		bool useConnectIndex = false;
 
 		std::vector<uint32_t> m_connectPrimId;
@@ -43,61 +60,185 @@ namespace Skhole {
 	//  v0 ------ v1
 	//       0
 
-	inline std::pair<uint32_t, uint32_t> GetEdge(uint32_t v0, uint32_t v1)
+	struct ConnectPrimIdStats {
+		std::atomic<size_t> currentBytes = 0;
+		std::atomic<size_t> peakBytes = 0;
+
+		void Allocate(size_t bytes) {
+			size_t current = currentBytes += bytes;
+			size_t peak = peakBytes.load();
+			while (current > peak && !peakBytes.compare_exchange_weak(peak, current)) {}
+		}
+
+		void Release(size_t bytes) {
+			currentBytes -= bytes;
+		}
+	};
+
+	// Stable LSD radix sort of edge keys together with their edge slot (primId * 3 + edge)
+	inline void RadixSortEdges(std::vector<uint64_t>& keys, std::vector<uint32_t>& slots, uint32_t keyBits, size_t minChunkSize)
 	{
-		if (v0 < v1)
-			return std::make_pair(v0, v1);
-		else
-			return std::make_pair(v1, v0);
+		constexpr uint32_t RADIX_BITS = 11;
+		constexpr size_t RADIX_SIZE = size_t(1) << RADIX_BITS;
+		constexpr uint64_t RADIX_MASK = RADIX_SIZE - 1;
+
+		const size_t numEdge = keys.size();
+		const size_t numChunk = GetParallelChunkCount(numEdge, minChunkSize);
+
+		std::vector<uint64_t> tmpKeys(numEdge);
+		std::vector<uint32_t> tmpSlots(numEdge);
+		std::vector<size_t> histogram(numChunk * RADIX_SIZE);
+
+		for (uint32_t shift = 0; shift < keyBits; shift += RADIX_BITS) {
+			std::fill(histogram.begin(), histogram.end(), 0);
+
+			ParallelForChunk(numEdge, minChunkSize, [&](size_t chunk, size_t begin, size_t end) {
+				size_t* hist = histogram.data() + chunk * RADIX_SIZE;
+				for (size_t i = begin; i < end; i++) {
+					hist[(keys[i] >> shift) & RADIX_MASK]++;
+				}
+				});
+
+			size_t offset = 0;
+			for (size_t digit = 0; digit < RADIX_SIZE; digit++) {
+				for (size_t chunk = 0; chunk < numChunk; chunk++) {
+					size_t count = histogram[chunk * RADIX_SIZE + digit];
+					histogram[chunk * RADIX_SIZE + digit] = offset;
+					offset += count;
+				}
+			}
+
+			ParallelForChunk(numEdge, minChunkSize, [&](size_t chunk, size_t begin, size_t end) {
+				size_t* hist = histogram.data() + chunk * RADIX_SIZE;
+				for (size_t i = begin; i < end; i++) {
+					size_t dst = hist[(keys[i] >> shift) & RADIX_MASK]++;
+					tmpKeys[dst] = keys[i];
+					tmpSlots[dst] = slots[i];
+				}
+				});
+
+			keys.swap(tmpKeys);
+			slots.swap(tmpSlots);
+		}
 	}
 
-	inline uint32_t GetPrimIdWithSharedEdge(const uint32_t myselfPrimId, const std::vector<uint32_t>& edgePrimId)
+	// Flat, sort based adjacency. Every edge is keyed by its sorted vertex pair,
+	// edges sharing a key form a run after sorting and a run of exactly two is a connection.
+	// Boundary and non-manifold edges get -1.
+	inline void BuildConnectPrimId(Geometry& geom, bool parallel, ConnectPrimIdStats& stats)
 	{
-		if (edgePrimId.size() == 2) {
-			if (edgePrimId[0] == myselfPrimId) {
-				return edgePrimId[1];
+		const auto& indices = geom.m_indices;
+		auto& connectIndices = geom.m_connectPrimId;
+
+		const size_t numEdge = (indices.size() / 3) * 3;
+		const size_t minChunkSize = parallel ? (size_t(1) << 16) : std::max<size_t>(numEdge, 1);
+
+		connectIndices.assign(indices.size(), uint32_t(-1));
+		if (numEdge == 0) {
+			geom.useConnectIndex = true;
+			return;
+		}
+
+		// keys, slots and their sort buffers
+		const size_t workingBytes = numEdge * (sizeof(uint64_t) + sizeof(uint32_t)) * 2;
+		stats.Allocate(workingBytes + connectIndices.size() * sizeof(uint32_t));
+
+		// Compact key range : minVertex * numVertex + maxVertex
+		std::vector<uint32_t> chunkMax(GetParallelChunkCount(numEdge, minChunkSize), 0);
+		ParallelForChunk(numEdge, minChunkSize, [&](size_t chunk, size_t begin, size_t end) {
+			uint32_t maxIndex = 0;
+			for (size_t i = begin; i < end; i++) {
+				maxIndex = std::max(maxIndex, indices[i]);
 			}
-			else {
-				return edgePrimId[0];
+			chunkMax[chunk] = maxIndex;
+			});
+		const uint64_t numVertex = uint64_t(*std::max_element(chunkMax.begin(), chunkMax.end())) + 1;
+
+		uint32_t vertexBits = 1;
+		while ((uint64_t(1) << vertexBits) < numVertex) vertexBits++;
+		const uint32_t keyBits = vertexBits * 2;
+
+		std::vector<uint64_t> keys(numEdge);
+		std::vector<uint32_t> slots(numEdge);
+		ParallelForChunk(numEdge / 3, minChunkSize / 3 + 1, [&](size_t, size_t begin, size_t end) {
+			for (size_t prim = begin; prim < end; prim++) {
+				for (uint32_t e = 0; e < 3; e++) {
+					size_t slot = prim * 3 + e;
+					uint32_t v0 = indices[slot];
+					uint32_t v1 = indices[prim * 3 + (e + 1) % 3];
+					if (v0 > v1) std::swap(v0, v1);
+
+					keys[slot] = uint64_t(v0) * numVertex + v1;
+					slots[slot] = static_cast<uint32_t>(slot);
+				}
 			}
-		}
-		else {
-			return -1;
-		}
+			});
+
+		RadixSortEdges(keys, slots, keyBits, minChunkSize);
+
+		// Each chunk handles the runs that start inside it
+		ParallelForChunk(numEdge, minChunkSize, [&](size_t, size_t begin, size_t end) {
+			size_t i = begin;
+			while (i > 0 && i < end && keys[i] == keys[i - 1]) i++;
+
+			while (i < end) {
+				size_t j = i + 1;
+				while (j < numEdge && keys[j] == keys[i]) j++;
+
+				if (j - i == 2) {
+					connectIndices[slots[i]] = slots[i + 1] / 3;
+					connectIndices[slots[i + 1]] = slots[i] / 3;
+				}
+
+				i = j;
+			}
+			});
+
+		stats.Release(workingBytes);
+		geom.useConnectIndex = true;
 	}
 
 	inline void CreateConnectPrimId(ShrPtr<Geometry>& geom)
 	{
-		auto& indices = geom->m_indices;
-		auto& connectIndices = geom->m_connectPrimId;
-		std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> edgeMap;
-
-		for (int i = 0; i < indices.size() / 3; i++)
-		{
-			uint32_t v0 = indices[i * 3 + 0];
-			uint32_t v1 = indices[i * 3 + 1];
-			uint32_t v2 = indices[i * 3 + 2];
-
-			edgeMap[GetEdge(v0, v1)].push_back(i);
-			edgeMap[GetEdge(v1, v2)].push_back(i);
-			edgeMap[GetEdge(v2, v0)].push_back(i);
-		}
+		Timer timer;
+		timer.Start();
+
+		ConnectPrimIdStats stats;
+		BuildConnectPrimId(*geom, true, stats);
 
-		connectIndices.resize(indices.size());
-		for (int i = 0; i < indices.size() / 3; i++)
-		{
-			// Serch Edge
-			uint32_t v0 = indices[i * 3 + 0];
-			uint32_t v1 = indices[i * 3 + 1];
-			uint32_t v2 = indices[i * 3 + 2];
-
-			connectIndices[i * 3 + 0] = GetPrimIdWithSharedEdge(i, edgeMap[GetEdge(v0, v1)]);
-			connectIndices[i * 3 + 1] = GetPrimIdWithSharedEdge(i, edgeMap[GetEdge(v1, v2)]);
-			connectIndices[i * 3 + 2] = GetPrimIdWithSharedEdge(i, edgeMap[GetEdge(v2, v0)]);
+		float time = timer.Stop();
+		SKHOLE_LOG("Created Connect Prim Id : " << geom->m_indices.size() / 3 << " prims, "
+			<< time * 1000.0f << " ms, peak " << stats.peakBytes / (1024.0 * 1024.0) << " MB");
+	}
+
+	// Large geometries use all workers one after another, small ones are processed side by side
+	inline void CreateConnectPrimIds(std::vector<ShrPtr<Geometry>>& geoms)
+	{
+		constexpr size_t LARGE_GEOMETRY_INDICES = size_t(3) << 16;
+
+		Timer timer;
+		timer.Start();
+
+		ConnectPrimIdStats stats;
+		std::vector<Geometry*> smallGeoms;
+		size_t numPrim = 0;
+
+		for (auto& geom : geoms) {
+			numPrim += geom->m_indices.size() / 3;
+			if (geom->m_indices.size() >= LARGE_GEOMETRY_INDICES) {
+				BuildConnectPrimId(*geom, true, stats);
+			}
+			else {
+				smallGeoms.push_back(geom.get());
+			}
 		}
 
-		geom->useConnectIndex = true;
+		ParallelForDynamic(smallGeoms.size(), [&](size_t i) {
+			BuildConnectPrimId(*smallGeoms[i], false, stats);
+			});
 
-		SKHOLE_LOG("Created Connecte Prim Id");
+		float time = timer.Stop();
+		SKHOLE_LOG("Created Connect Prim Id : " << geoms.size() << " geometries, " << numPrim << " prims, "
+			<< time * 1000.0f << " ms, peak " << stats.peakBytes / (1024.0 * 1024.0) << " MB");
 	}
 }
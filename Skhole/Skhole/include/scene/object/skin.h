@@ -0,0 +1,100 @@
+#pragma once
+
+#include <include.h>
+#include <common/math.h>
+#include <scene/object/object.h>
+
+#include <unordered_map>
+
+using namespace VectorLikeGLSL;
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Skin
+	//-----------------------------------------------------
+	// Joints are scene objects animated by their Animation tracks.
+	// A skinned geometry keeps its bind pose vertices and is posed on the GPU (SkinningPass).
+	class Skin {
+	public:
+		Skin() {};
+		~Skin() {};
+
+		std::string skinName;
+
+		// Object index of each joint
+		std::vector<uint32_t> jointObjects;
+		std::vector<mat4> inverseBindMatrices;
+	};
+
+	// 3x4 row major, same layout as the instance transform
+	struct JointMatrix {
+		float m[3][4];
+	};
+
+	// a * b on column vectors, b is applied first
+	inline mat4 AffineMul(const mat4& a, const mat4& b) {
+		mat4 result(0);
+		for (int r = 0; r < 4; r++) {
+			for (int c = 0; c < 4; c++) {
+				result[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c] + a[r][3] * b[3][c];
+			}
+		}
+		return result;
+	}
+
+	inline mat4 AffineInverse(const mat4& m) {
+		mat3 m3x3(0);
+		m3x3[0] = m[0].xyz;
+		m3x3[1] = m[1].xyz;
+		m3x3[2] = m[2].xyz;
+		mat3 inv = Inverse3x3(m3x3);
+
+		mat4 result(0);
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				result[r][c] = inv[r][c];
+			}
+			result[r][3] = -(inv[r][0] * m[0][3] + inv[r][1] * m[1][3] + inv[r][2] * m[2][3]);
+		}
+		result[3][3] = 1.0f;
+		return result;
+	}
+
+	// World matrix without the cache of Object, a joint whose sibling is animated is not reset by Scene::SetTransformMatrix
+	inline mat4 EvaluateWorldMatrix(Object* object, float time, std::unordered_map<Object*, mat4>& cache) {
+		auto found = cache.find(object);
+		if (found != cache.end()) return found->second;
+
+		mat4 world = object->GetTransformMatrix(time);
+		if (object->haveParent()) {
+			world = AffineMul(EvaluateWorldMatrix(object->parentObject.get(), time, cache), world);
+		}
+
+		cache.emplace(object, world);
+		return world;
+	}
+
+	// Joint matrices relative to the object placing the geometry, the instance transform is applied by the TLAS.
+	// dst : skin.jointObjects.size() matrices
+	inline void EvaluateJointMatrices(
+		const Skin& skin,
+		const std::vector<ShrPtr<Object>>& objects,
+		uint32_t meshObject,
+		float time,
+		std::unordered_map<Object*, mat4>& cache,
+		JointMatrix* dst
+	) {
+		mat4 meshWorldInverse = AffineInverse(EvaluateWorldMatrix(objects[meshObject].get(), time, cache));
+
+		for (size_t j = 0; j < skin.jointObjects.size(); j++) {
+			mat4 jointWorld = EvaluateWorldMatrix(objects[skin.jointObjects[j]].get(), time, cache);
+			mat4 joint = AffineMul(meshWorldInverse, AffineMul(jointWorld, skin.inverseBindMatrices[j]));
+
+			for (int r = 0; r < 3; r++) {
+				for (int c = 0; c < 4; c++) {
+					dst[j].m[r][c] = joint[r][c];
+				}
+			}
+		}
+	}
+}
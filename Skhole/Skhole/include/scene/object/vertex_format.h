@@ -0,0 +1,193 @@
+#pragma once
+
+#include <include.h>
+#include <scene/object/geometry.h>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Vertex Format
+	//-----------------------------------------------------
+	// Encoding of the GPU vertex attribute streams (positions are always float3).
+	// STANDARD : normal float3, texcoord float2, color float4
+	// COMPACT  : normal octahedral snorm16x2, texcoord half2, color unorm8x4 (4 bytes each)
+	enum class VertexFormat : uint32_t {
+		STANDARD = 0,
+		COMPACT = 1,
+	};
+
+	inline const char* VertexFormat2Name(VertexFormat format) {
+		switch (format) {
+		case VertexFormat::COMPACT:
+			return "Compact";
+		default:
+			return "Standard";
+		}
+	}
+
+	inline VertexFormat Name2VertexFormat(const std::string& name) {
+		if (name == "Compact") return VertexFormat::COMPACT;
+		return VertexFormat::STANDARD;
+	}
+
+	// Attribute streams, stored separately per geometry
+	enum VertexAttribute : uint32_t {
+		VERTEX_ATTRIBUTE_NORMAL = 0,
+		VERTEX_ATTRIBUTE_TEXCOORD0,
+		VERTEX_ATTRIBUTE_TEXCOORD1,
+		VERTEX_ATTRIBUTE_COLOR,
+		VERTEX_ATTRIBUTE_COUNT,
+	};
+
+	constexpr uint32_t VERTEX_ATTRIBUTE_BIT_NORMAL = 1u << VERTEX_ATTRIBUTE_NORMAL;
+	constexpr uint32_t VERTEX_ATTRIBUTE_BIT_TEXCOORD0 = 1u << VERTEX_ATTRIBUTE_TEXCOORD0;
+	constexpr uint32_t VERTEX_ATTRIBUTE_BIT_TEXCOORD1 = 1u << VERTEX_ATTRIBUTE_TEXCOORD1;
+	constexpr uint32_t VERTEX_ATTRIBUTE_BIT_COLOR = 1u << VERTEX_ATTRIBUTE_COLOR;
+	constexpr uint32_t VERTEX_ATTRIBUTE_BIT_ALL = (1u << VERTEX_ATTRIBUTE_COUNT) - 1;
+
+	// Offset of a stream that is not stored
+	constexpr uint32_t VERTEX_ATTRIBUTE_NONE = 0xFFFFFFFF;
+
+	// Size of one element in 4 byte words
+	inline uint32_t GetVertexAttributeWordCount(VertexAttribute attribute, VertexFormat format) {
+		if (format == VertexFormat::COMPACT) return 1;
+
+		switch (attribute) {
+		case VERTEX_ATTRIBUTE_NORMAL:
+			return 3;
+		case VERTEX_ATTRIBUTE_TEXCOORD0:
+		case VERTEX_ATTRIBUTE_TEXCOORD1:
+			return 2;
+		case VERTEX_ATTRIBUTE_COLOR:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	inline uint32_t FloatBits(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	// Same as GLSL packHalf2x16 (round to nearest even)
+	inline uint16_t FloatToHalf(float value) {
+		uint32_t bits = FloatBits(value);
+
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t exponent = (bits >> 23) & 0xFF;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		// Inf, NaN
+		if (exponent == 0xFF) {
+			return uint16_t(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+		}
+
+		int32_t halfExponent = int32_t(exponent) - 127 + 15;
+		if (halfExponent >= 31) {
+			return uint16_t(sign | 0x7C00);
+		}
+
+		if (halfExponent <= 0) {
+			// Subnormal or zero
+			if (halfExponent < -10) return uint16_t(sign);
+			mantissa |= 0x800000;
+			uint32_t shift = uint32_t(14 - halfExponent);
+			uint32_t halfMantissa = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (halfMantissa & 1))) halfMantissa++;
+			return uint16_t(sign | halfMantissa);
+		}
+
+		uint32_t half = sign | (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1FFF;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // may carry into the exponent, which is correct
+		return uint16_t(half);
+	}
+
+	inline uint32_t PackHalf2x16(float x, float y) {
+		return uint32_t(FloatToHalf(x)) | (uint32_t(FloatToHalf(y)) << 16);
+	}
+
+	inline uint32_t PackSnorm2x16(float x, float y) {
+		auto pack = [](float v) {
+			v = std::clamp(v, -1.0f, 1.0f);
+			return uint32_t(uint16_t(int16_t(std::round(v * 32767.0f))));
+			};
+		return pack(x) | (pack(y) << 16);
+	}
+
+	inline uint32_t PackUnorm4x8(float x, float y, float z, float w) {
+		auto pack = [](float v) {
+			v = std::clamp(v, 0.0f, 1.0f);
+			return uint32_t(std::round(v * 255.0f));
+			};
+		return pack(x) | (pack(y) << 8) | (pack(z) << 16) | (pack(w) << 24);
+	}
+
+	// Octahedral normal encoding, decoded by OctDecode in the shader
+	inline uint32_t PackOctNormal(float x, float y, float z) {
+		float sum = std::abs(x) + std::abs(y) + std::abs(z);
+		if (sum <= 0.0f) return PackSnorm2x16(0.0f, 0.0f);
+
+		x /= sum;
+		y /= sum;
+		if (z < 0.0f) {
+			float ox = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float oy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = ox;
+			y = oy;
+		}
+
+		return PackSnorm2x16(x, y);
+	}
+
+	// Writes one attribute of vertices[0, count) to dst, GetVertexAttributeWordCount words per vertex
+	inline void WriteVertexAttribute(VertexAttribute attribute, VertexFormat format, const VertexData* vertices, size_t count, uint32_t* dst) {
+		const bool compact = format == VertexFormat::COMPACT;
+
+		for (size_t i = 0; i < count; i++) {
+			const auto& vert = vertices[i];
+
+			switch (attribute) {
+			case VERTEX_ATTRIBUTE_NORMAL:
+				if (compact) {
+					*dst++ = PackOctNormal(vert.normal.x, vert.normal.y, vert.normal.z);
+				}
+				else {
+					*dst++ = FloatBits(vert.normal.x);
+					*dst++ = FloatBits(vert.normal.y);
+					*dst++ = FloatBits(vert.normal.z);
+				}
+				break;
+			case VERTEX_ATTRIBUTE_TEXCOORD0:
+			case VERTEX_ATTRIBUTE_TEXCOORD1: {
+				const float* texcoord = (attribute == VERTEX_ATTRIBUTE_TEXCOORD0) ? vert.texcoord0 : vert.texcoord1;
+				if (compact) {
+					*dst++ = PackHalf2x16(texcoord[0], texcoord[1]);
+				}
+				else {
+					*dst++ = FloatBits(texcoord[0]);
+					*dst++ = FloatBits(texcoord[1]);
+				}
+				break;
+			}
+			case VERTEX_ATTRIBUTE_COLOR:
+				if (compact) {
+					*dst++ = PackUnorm4x8(vert.color.x, vert.color.y, vert.color.z, vert.color.w);
+				}
+				else {
+					*dst++ = FloatBits(vert.color.x);
+					*dst++ = FloatBits(vert.color.y);
+					*dst++ = FloatBits(vert.color.z);
+					*dst++ = FloatBits(vert.color.w);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
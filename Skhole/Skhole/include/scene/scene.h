@@ -6,7 +6,9 @@
 #include <scene/material/material.h>
 #include <scene/object/object.h>
 #include <scene/object/geometry.h>
+#include <scene/object/vertex_format.h>
 #include <scene/object/instance.h>
+#include <scene/object/skin.h>
 #include <scene/camera/camera.h>
 #include <scene/parameter/renderer_parameter.h>
 
@@ -38,9 +40,13 @@ namespace Skhole {
 		std::vector<ShrPtr<RendererDefinisionMaterial>> m_materials;
 		std::vector<ShrPtr<BasicMaterial>> m_basicMaterials;
 		std::vector<ShrPtr<Texture>> m_textures;
+		std::vector<ShrPtr<Skin>> m_skins;
 
 		std::vector<uint32_t> m_cameraObjectIndices;
 
+		// Vertex layout of the GPU vertex buffer
+		VertexFormat m_vertexFormat = VertexFormat::STANDARD;
+
 		ShrPtr<RendererDefinisionCamera> m_camera;
 
 		ShrPtr<RendererParameter> m_rendererParameter;
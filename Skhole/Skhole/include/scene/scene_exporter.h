@@ -3,6 +3,9 @@
 #include <include.h>
 #include <scene/scene.h>
 #include <scene/animation/animation.h>
+#include <scene/geometry_container.h>
+#include <scene/geometry_text.h>
+#include <common/mapped_file.h>
 #include <nlohmann/json.hpp>
 #include <renderer/renderer.h>
 #include <renderer/core/vndf_renderer.h>
@@ -161,9 +164,8 @@ namespace Skhole
 	}
 
 
-	inline bool ExportObjects(const std::string& filepath, const std::string& filename, const std::vector<ShrPtr<Object>>& objects)
+	inline bool WriteObjects(std::ostream& file, const std::vector<ShrPtr<Object>>& objects)
 	{
-		std::ofstream file(filepath + filename);
 		file << "Object" << std::endl;
 		file << objects.size() << std::endl;
 		file << std::endl;
@@ -176,13 +178,15 @@ namespace Skhole
 		for (auto& obj : objects)
 		{
 			file << "#Object" << std::endl;
-			file << "Name " << obj->objectName << std::endl;
+			// Length prefixed, names may be empty or contain spaces
+			file << "NameSize " << obj->objectName.size() << " " << obj->objectName << std::endl;
 
 			file << "#Features" << std::endl;
 			file << "Type " << ObjectType2Name(obj->GetObjectType()) << std::endl;
 			if (obj->GetObjectType() == ObjectType::INSTANCE) {
 				auto instance = std::dynamic_pointer_cast<Instance>(obj);
-				file << "GeometryIndex " << instance->geometryIndex.value() << std::endl;
+				// -1 : transform only instance (joint, group)
+				file << "GeometryIndex " << (instance->geometryIndex.has_value() ? int64_t(instance->geometryIndex.value()) : int64_t(-1)) << std::endl;
 			}
 			else if (obj->GetObjectType() == ObjectType::CAMERA) {
 				auto camera = std::dynamic_pointer_cast<CameraObject>(obj);
@@ -246,48 +250,46 @@ namespace Skhole
 			file << std::endl;
 		}
 
-		file.close();
 		return true;
 	}
 
-	inline bool ExportGeometries(const std::string& filepath, const std::string& filename, const std::vector<ShrPtr<Geometry>>& geoms) {
+	inline bool ExportObjects(const std::string& filepath, const std::string& filename, const std::vector<ShrPtr<Object>>& objects)
+	{
 		std::ofstream file(filepath + filename);
-		file << "Geometries" << std::endl;
-		file << geoms.size() << std::endl;
-		file << std::endl;
+		if (!file.is_open()) {
+			SKHOLE_ERROR("Failed to open file : " + filepath + filename);
+			return false;
+		}
 
-		int index = 0;
-		for (const auto& geometry : geoms) {
-			file << "#Geom" << index << std::endl;
-			file << "#Vertices " << geometry->m_vertices.size() << std::endl;
-			for (const auto& vert : geometry->m_vertices) {
-				file << "vp " << vert.position.x << " " << vert.position.y << " " << vert.position.z << " " << vert.position.w << std::endl;
-				file << "vn " << vert.normal.x << " " << vert.normal.y << " " << vert.normal.z << " " << vert.normal.w << std::endl;
-				file << "vt0 " << vert.texcoord0[0] << " " << vert.texcoord0[1] << std::endl;
-				file << "vt1 " << vert.texcoord1[0] << " " << vert.texcoord1[1] << std::endl;
-				file << "vc " << vert.color.x << " " << vert.color.y << " " << vert.color.z << " " << vert.color.w << std::endl;
-			}
+		WriteObjects(file, objects);
+		file.close();
+		return true;
+	}
 
-			file << "#Indices " << geometry->m_indices.size() << std::endl;
-			for (const auto& index : geometry->m_indices) {
-				file << index << " ";
-			}
-			file << std::endl;
+	inline bool ExportGeometries(const std::string& filepath, const std::string& filename, const std::vector<ShrPtr<Geometry>>& geoms) {
+		std::ofstream file(filepath + filename);
+		if (!file.is_open()) {
+			SKHOLE_ERROR("Failed to open file : " + filepath + filename);
+			return false;
+		}
 
-			file << "#MaterialIndices " << geometry->m_materialIndices.size() << std::endl;
-			for (const auto& index : geometry->m_materialIndices) {
-				file << index << " ";
-			}
-			file << std::endl;
+		bool result = WriteGeometriesText(file, geoms);
+		file.close();
 
-			file << std::endl;
+		return result;
+	}
 
-			index++;
+	inline bool ExportGeometriesBinary(const std::string& filepath, const std::string& filename, const std::vector<ShrPtr<Geometry>>& geoms) {
+		std::ofstream file(filepath + filename, std::ios::binary);
+		if (!file.is_open()) {
+			SKHOLE_ERROR("Failed to open file : " + filepath + filename);
+			return false;
 		}
 
+		bool result = WriteGeometryContainer(file, geoms);
 		file.close();
 
-		return true;
+		return result;
 	}
 
 
@@ -383,7 +385,7 @@ namespace Skhole
 		return true;
 	}
 
-	inline bool ExportScene(const std::string& filepath, const std::string& filename, const ShrPtr<Scene>& scene, nlohmann::json& sJs) {
+	inline bool ExportScene(const std::string& filepath, const std::string& filename, const ShrPtr<Scene>& scene, bool binaryGeometry, nlohmann::json& sJs) {
 		auto& objects = scene->m_objects;
 		auto& geometries = scene->m_geometies;
 		auto& materials = scene->m_materials;
@@ -407,11 +409,24 @@ namespace Skhole
 		ExportObjects(filepath, objectFilename, objects);
 
 		//Geometry
-		std::string geometryFilename = filename + ".skgeom";
-		sJs["Geometries"] = {
-			{"Filename", geometryFilename}
-		};
-		ExportGeometries(filepath, geometryFilename, geometries);
+		if (binaryGeometry) {
+			std::string geometryFilename = filename + ".skgeomb";
+			sJs["Geometries"] = {
+				{"Filename", geometryFilename},
+				{"Format", "Binary"},
+				{"VertexFormat", VertexFormat2Name(scene->m_vertexFormat)}
+			};
+			ExportGeometriesBinary(filepath, geometryFilename, geometries);
+		}
+		else {
+			std::string geometryFilename = filename + ".skgeom";
+			sJs["Geometries"] = {
+				{"Filename", geometryFilename},
+				{"Format", "Text"},
+				{"VertexFormat", VertexFormat2Name(scene->m_vertexFormat)}
+			};
+			ExportGeometries(filepath, geometryFilename, geometries);
+		}
 
 		//Materials
 		nlohmann::json matJs;
@@ -455,6 +470,8 @@ namespace Skhole
 		std::string filename;
 		ShrPtr<Scene> scene;
 		OfflineRenderingInfo offlineRenderingInfo;
+
+		bool binaryGeometry = true;
 	};
 
 	inline bool ExportSetting(const ExportSettingDesc& desc) {
@@ -482,7 +499,7 @@ namespace Skhole
 
 		nlohmann::json sceneJs;
 		// Scene Setting
-		ExportScene(filepath, filename, desc.scene, sceneJs);
+		ExportScene(filepath, filename, desc.scene, desc.binaryGeometry, sceneJs);
 
 		rJs["Scene"] = sceneJs;
 
@@ -502,21 +519,19 @@ namespace Skhole
 		OfflineRenderingInfo offlineRenderingInfo;
 	};
 
-	inline bool ImportObjects(const std::string& path, std::vector<ShrPtr<Object>>& objects) {
-		std::ifstream read_file(path);
-
-		if (!read_file.is_open()) {
-			SKHOLE_LOG("Failed to open file : " + path);
-			return false;
-		}
+	constexpr size_t MAX_OBJECT_NAME_SIZE = 1 << 16;
 
+	// Returns false on a parse error, objects may be partly filled then
+	inline bool ReadObjects(std::istream& read_file, std::vector<ShrPtr<Object>>& objects) {
 		std::string prefix;
 		read_file >> prefix;
 
 		if (prefix != "Object") return false;
 
-		int numObj;
+		int numObj = -1;
 		read_file >> numObj;
+		if (!read_file || numObj < 0) return false;
+
 		objects.reserve(numObj);
 		std::vector<std::pair<int, int>> parentChildIndex;
 		parentChildIndex.reserve(numObj);
@@ -528,7 +543,18 @@ namespace Skhole
 			std::string objType;
 
 			read_file >> prefix;
-			read_file >> objName;
+			if (prefix == "NameSize") {
+				size_t nameSize = 0;
+				read_file >> nameSize;
+				if (!read_file || nameSize > MAX_OBJECT_NAME_SIZE) return false;
+				read_file.get();
+				objName.resize(nameSize);
+				read_file.read(objName.data(), nameSize);
+			}
+			else {
+				// Files written before NameSize, the name is one token
+				read_file >> objName;
+			}
 			read_file >> prefix;
 			read_file >> prefix;
 			read_file >> objType;
@@ -536,10 +562,10 @@ namespace Skhole
 			ShrPtr<Object> object;
 			if (objType == ObjectType2Name(ObjectType::INSTANCE)) {
 				std::shared_ptr<Instance> instance = MakeShr<Instance>();
-				uint32_t index;
+				int64_t index;
 				read_file >> prefix;
 				read_file >> index;
-				instance->geometryIndex = index;
+				if (index >= 0) instance->geometryIndex = static_cast<uint32_t>(index);
 				object = instance;
 			}
 			else if (objType == ObjectType2Name(ObjectType::CAMERA)) {
@@ -550,7 +576,8 @@ namespace Skhole
 				object = camera;
 			}
 			else {
-				SKHOLE_UNIMPL();
+				SKHOLE_ERROR("Unknown object type : " << objType);
+				return false;
 			}
 
 			object->objectName = objName;
@@ -620,11 +647,17 @@ namespace Skhole
 						}
 					}
 					else {
-						SKHOLE_UNIMPL();
+						SKHOLE_ERROR("Unknown animation type : " << animType);
+						return false;
 					}
 				}
 			}
 
+			if (!read_file) {
+				SKHOLE_ERROR("Failed to read object " << i);
+				return false;
+			}
+
 			objects.push_back(object);
 		} // object roop
 
@@ -633,6 +666,11 @@ namespace Skhole
 		{
 			auto& obj = objects[i];
 			auto& pcindex = parentChildIndex[i];
+			if (pcindex.first < -1 || pcindex.first >= numObj || pcindex.second < -1 || pcindex.second >= numObj) {
+				SKHOLE_ERROR("Invalid parent or child index of object " << i);
+				return false;
+			}
+
 			if (pcindex.first != -1) {
 				obj->parentObject = objects[pcindex.first];
 			}
@@ -641,89 +679,50 @@ namespace Skhole
 			}
 		}
 
-		read_file.close();
-
+		return true;
 	}
 
-	inline bool ImportGeometry(const std::string& path, std::vector<ShrPtr<Geometry>>& geometry) {
+	inline bool ImportObjects(const std::string& path, std::vector<ShrPtr<Object>>& objects) {
 		std::ifstream read_file(path);
+
 		if (!read_file.is_open()) {
 			SKHOLE_LOG("Failed to open file : " + path);
 			return false;
 		}
 
-		std::string prefix;
-		read_file >> prefix;
-
-		if (prefix != "Geometries") return false;
-
-		int numGeom;
-		read_file >> numGeom;
-
-		geometry.reserve(numGeom);
-
-		for (int i = 0; i < numGeom; i++) {
-			ShrPtr<Geometry> geom = MakeShr<Geometry>();
-			read_file >> prefix;
-
-			// Vertices
-			read_file >> prefix;
-			if (prefix != "#Vertices") return false;
-			int numVert;
-			read_file >> numVert;
-			geom->m_vertices.reserve(numVert);
-
-			for (int j = 0; j < numVert; j++) {
-				VertexData vert;
-				read_file >> prefix;
-
-				read_file >> vert.position.v[0] >> vert.position.v[1] >> vert.position.v[2] >> vert.position.v[3];
-
-				read_file >> prefix;
-				read_file >> vert.normal.v[0] >> vert.normal.v[1] >> vert.normal.v[2] >> vert.normal.v[3];
-
-				read_file >> prefix;
-				read_file >> vert.texcoord0[0] >> vert.texcoord0[1];
-
-				read_file >> prefix;
-				read_file >> vert.texcoord1[0] >> vert.texcoord1[1];
+		bool result = ReadObjects(read_file, objects);
+		read_file.close();
 
-				read_file >> prefix;
-				read_file >> vert.color.v[0] >> vert.color.v[1] >> vert.color.v[2] >> vert.color.v[3];
+		return result;
+	}
 
-				geom->m_vertices.push_back(vert);
-			}
+	inline bool ImportGeometry(const std::string& path, std::vector<ShrPtr<Geometry>>& geometry) {
+		MappedFile file;
+		if (!file.Open(path)) {
+			SKHOLE_LOG("Failed to open file : " + path);
+			return false;
+		}
 
-			//Indices
-			read_file >> prefix;
-			if (prefix != "#Indices") return false;
-			int numIndex;
-			read_file >> numIndex;
-			geom->m_indices.reserve(numIndex);
+		Timer timer;
+		timer.Start();
 
-			for (int j = 0; j < numIndex; j++) {
-				uint32_t index;
-				read_file >> index;
-				geom->m_indices.push_back(index);
-			}
+		if (!ReadGeometriesText(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), geometry)) {
+			return false;
+		}
 
-			//MaterialIndices
-			read_file >> prefix;
-			if (prefix != "#MaterialIndices") return false;
-			int numMatIndex;
-			read_file >> numMatIndex;
-			geom->m_materialIndices.reserve(numMatIndex);
+		float time = timer.Stop();
+		SKHOLE_LOG("Import Geometry : " << file.GetSize() / (1024.0 * 1024.0) << " MB, " << time * 1000.0f << " ms");
 
-			for (int j = 0; j < numMatIndex; j++) {
-				uint32_t index;
-				read_file >> index;
-				geom->m_materialIndices.push_back(index);
-			}
+		return true;
+	}
 
-			geometry.push_back(geom);
+	inline bool ImportGeometryBinary(const std::string& path, std::vector<ShrPtr<Geometry>>& geometry) {
+		MappedFile file;
+		if (!file.Open(path)) {
+			return false;
 		}
 
-		read_file.close();
+		return ReadGeometryContainer(file.GetData(), file.GetSize(), geometry);
 	}
 
 
@@ -787,6 +786,7 @@ namespace Skhole
 		filename = DeleteFileExtension(file);
 
 		std::string geomExt = ".skgeom";
+		std::string geomBinaryExt = ".skgeomb";
 		std::string objExt = ".skobj";
 
 		read_file >> loadJs;
@@ -831,8 +831,25 @@ namespace Skhole
 		SKHOLE_LOG("Renderer Parameter Loaded");
 
 		// Geometry
-		std::string geomPath = path + filename + geomExt;
-		ImportGeometry(geomPath, scene->m_geometies);
+		auto& geomJs = sceneJs["Geometries"];
+		bool binaryGeometry = geomJs.contains("Format") && geomJs["Format"] == "Binary";
+		bool geometryLoaded = false;
+		if (binaryGeometry) {
+			geometryLoaded = ImportGeometryBinary(path + filename + geomBinaryExt, scene->m_geometies);
+			if (!geometryLoaded) {
+				SKHOLE_WARN("Failed to load binary geometry, fall back to text geometry");
+				scene->m_geometies.clear();
+			}
+		}
+		if (!geometryLoaded) {
+			std::string geomPath = path + filename + geomExt;
+			ImportGeometry(geomPath, scene->m_geometies);
+		}
+
+		if (geomJs.contains("VertexFormat")) {
+			std::string vertexFormat = geomJs["VertexFormat"];
+			scene->m_vertexFormat = Name2VertexFormat(vertexFormat);
+		}
 
 		SKHOLE_LOG("Geometry Loaded");
 
@@ -1,20 +1,23 @@
 #pragma once
 #include <include.h>
 #include <vulkan_helpler/vkutils.hpp>
+#include <vulkan_helpler/vk_memory.h>
 
 namespace Skhole {
 	struct Buffer {
+		MemoryAllocation allocation; // Declared first, so it is freed after the buffer
 		vk::UniqueBuffer buffer;
-		vk::UniqueDeviceMemory memory;
 		vk::DeviceAddress address{};
 		size_t bufferSize;
 
+		// lifetime : Transient for scratch buffers freed right after use, see MemoryAllocator
 		void Init(vk::PhysicalDevice physicalDevice,
 			vk::Device device,
 			vk::DeviceSize size,
 			vk::BufferUsageFlags usage,
 			vk::MemoryPropertyFlags memoryProperty,
-			const void* data = nullptr) {
+			const void* data = nullptr,
+			MemoryLifetime lifetime = MemoryLifetime::LongLived) {
 			// Create buffer
 			vk::BufferCreateInfo createInfo{};
 			createInfo.setSize(size);
@@ -25,27 +28,14 @@ namespace Skhole {
 			// Allocate memory
 			vk::MemoryRequirements memoryReq =
 				device.getBufferMemoryRequirements(*buffer);
-			vk::MemoryAllocateFlagsInfo allocateFlags{};
-			if (usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
-				allocateFlags.flags = vk::MemoryAllocateFlagBits::eDeviceAddress;
-			}
-
-			uint32_t memoryType = vkutils::getMemoryType(physicalDevice,  //
-				memoryReq, memoryProperty);
-			vk::MemoryAllocateInfo allocateInfo{};
-			allocateInfo.setAllocationSize(memoryReq.size);
-			allocateInfo.setMemoryTypeIndex(memoryType);
-			allocateInfo.setPNext(&allocateFlags);
-			memory = device.allocateMemoryUnique(allocateInfo);
+			allocation = GetMemoryAllocator().Allocate(physicalDevice, device, memoryReq, memoryProperty, lifetime, false);
 
 			// Bind buffer to memory
-			device.bindBufferMemory(*buffer, *memory, 0);
+			device.bindBufferMemory(*buffer, allocation.memory, allocation.offset);
 
 			// Copy data
 			if (data) {
-				void* mappedPtr = device.mapMemory(*memory, 0, size);
-				memcpy(mappedPtr, data, size);
-				device.unmapMemory(*memory);
+				memcpy(allocation.mapped, data, size);
 			}
 
 			// Get address
@@ -56,20 +46,19 @@ namespace Skhole {
 			}
 		}
 
+		// Host visible blocks stay mapped, Map only offsets the pointer
 		void* Map(vk::Device device, uint32_t offset, uint32_t size) {
-			return device.mapMemory(*memory, offset, size);
+			return allocation.mapped + offset;
 		}
 
 		void Unmap(vk::Device device) {
-			device.unmapMemory(*memory);
 		}
 
 		void Release(vk::Device device) {
 			device.destroyBuffer(*buffer);
-			device.freeMemory(*memory);
+			allocation.Free();
 
 			*buffer = VK_NULL_HANDLE;
-			*memory = VK_NULL_HANDLE;
 		}
 
 		vk::Buffer GetBuffer() {
@@ -87,6 +76,21 @@ namespace Skhole {
 		uint32_t bufferSize;
 
 		void Init(
+			vk::PhysicalDevice physicalDevice,
+			vk::Device device,
+			vk::DeviceSize size,
+			vk::BufferUsageFlags usage,
+			vk::MemoryPropertyFlags memoryProperty,
+			MemoryLifetime lifetime = MemoryLifetime::LongLived
+		)
+		{
+			hostBuffer.Init(physicalDevice, device, size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, nullptr, lifetime);
+			deviceBuffer.Init(physicalDevice, device, size, usage | vk::BufferUsageFlagBits::eTransferDst, memoryProperty, nullptr, lifetime);
+			bufferSize = size;
+		}
+
+		// No staging buffer, the data is written through UploadManager::Stream
+		void InitDevice(
 			vk::PhysicalDevice physicalDevice,
 			vk::Device device,
 			vk::DeviceSize size,
@@ -94,7 +98,6 @@ namespace Skhole {
 			vk::MemoryPropertyFlags memoryProperty
 		)
 		{
-			hostBuffer.Init(physicalDevice, device, size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 			deviceBuffer.Init(physicalDevice, device, size, usage | vk::BufferUsageFlagBits::eTransferDst, memoryProperty);
 			bufferSize = size;
 		}
@@ -135,6 +138,13 @@ namespace Skhole {
 				});
 		}
 
+		// Records the copy into a command buffer submitted by the caller, the host buffer has to stay untouched until it completes
+		void RecordUpload(vk::CommandBuffer commandBuffer) {
+			vk::BufferCopy copyRegion{};
+			copyRegion.setSize(bufferSize);
+			commandBuffer.copyBuffer(*hostBuffer.buffer, *deviceBuffer.buffer, copyRegion);
+		}
+
 		vk::Buffer GetDeviceBuffer() {
 			return *deviceBuffer.buffer;
 		}
@@ -158,6 +168,61 @@ namespace Skhole {
 		}
 	};
 
+	// Host visible buffer with one slice per frame in flight, mapped while it lives.
+	// Slices are aligned for dynamic offsets, so one descriptor serves every frame.
+	struct FrameRingBuffer {
+		Buffer buffer;
+		vk::DeviceSize sliceSize = 0;
+		vk::DeviceSize dataSize = 0;
+
+		void Init(vk::PhysicalDevice physicalDevice,
+			vk::Device device,
+			vk::DeviceSize size,
+			vk::BufferUsageFlags usage,
+			uint32_t numFrame,
+			MemoryLifetime lifetime = MemoryLifetime::LongLived) {
+			auto limits = physicalDevice.getProperties().limits;
+
+			vk::DeviceSize alignment = 1;
+			if (usage & vk::BufferUsageFlagBits::eUniformBuffer) {
+				alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+			}
+			if (usage & vk::BufferUsageFlagBits::eStorageBuffer) {
+				alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+			}
+
+			dataSize = size;
+			sliceSize = (size + alignment - 1) / alignment * alignment;
+			buffer.Init(physicalDevice, device, sliceSize * numFrame, usage,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+				nullptr, lifetime);
+		}
+
+		void* GetSlice(uint32_t frameIndex) {
+			return buffer.allocation.mapped + GetOffset(frameIndex);
+		}
+
+		// Dynamic offset of frameIndex
+		uint32_t GetOffset(uint32_t frameIndex) {
+			return static_cast<uint32_t>(frameIndex * sliceSize);
+		}
+
+		vk::Buffer GetBuffer() {
+			return *buffer.buffer;
+		}
+
+		// Descriptor range, one slice
+		vk::DeviceSize GetRange() {
+			return dataSize;
+		}
+
+		void Release(vk::Device device) {
+			buffer.Release(device);
+			sliceSize = 0;
+			dataSize = 0;
+		}
+	};
+
 	struct AccelStruct {
 		vk::UniqueAccelerationStructureKHR accel;
 		Buffer buffer;
@@ -182,28 +247,21 @@ namespace Skhole {
 					vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo,
 					primitiveCount);
 
-			// Create buffer for AS
-			buffer.Init(physicalDevice, device,
-				buildSizes.accelerationStructureSize,
-				vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-				vk::MemoryPropertyFlagBits::eDeviceLocal);
+			Create(physicalDevice, device, type, buildSizes.accelerationStructureSize);
 
-			// Create AS
-			vk::AccelerationStructureCreateInfoKHR createInfo{};
-			createInfo.setBuffer(*buffer.buffer);
-			createInfo.setSize(buildSizes.accelerationStructureSize);
-			createInfo.setType(type);
-			accel = device.createAccelerationStructureKHRUnique(createInfo);
+			// Create scratch buffer, padded so the address can be aligned to minAccelerationStructureScratchOffsetAlignment
+			vk::DeviceSize scratchAlignment = std::max<vk::DeviceSize>(
+				vkutils::getAccelerationStructureProps(physicalDevice).minAccelerationStructureScratchOffsetAlignment, 1);
 
-			// Create scratch buffer
 			Buffer scratchBuffer;
-			scratchBuffer.Init(physicalDevice, device, buildSizes.buildScratchSize,
+			scratchBuffer.Init(physicalDevice, device, buildSizes.buildScratchSize + scratchAlignment,
 				vk::BufferUsageFlagBits::eStorageBuffer |
 				vk::BufferUsageFlagBits::eShaderDeviceAddress,
-				vk::MemoryPropertyFlagBits::eDeviceLocal);
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				nullptr, MemoryLifetime::Transient);
 
 			buildInfo.setDstAccelerationStructure(*accel);
-			buildInfo.setScratchData(scratchBuffer.address);
+			buildInfo.setScratchData((scratchBuffer.address + scratchAlignment - 1) / scratchAlignment * scratchAlignment);
 
 			vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
 			buildRangeInfo.setPrimitiveCount(primitiveCount);
@@ -219,12 +277,37 @@ namespace Skhole {
 					&buildRangeInfo);
 				});
 
-			// Get address
+			UpdateAddress(device);
+		}
+
+		// Creates the storage buffer and an empty AS, the build is recorded by the caller
+		void Create(vk::PhysicalDevice physicalDevice,
+			vk::Device device,
+			vk::AccelerationStructureTypeKHR type,
+			vk::DeviceSize size) {
+			// Create buffer for AS
+			buffer.Init(physicalDevice, device, size,
+				vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+				vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+			// Create AS
+			vk::AccelerationStructureCreateInfoKHR createInfo{};
+			createInfo.setBuffer(*buffer.buffer);
+			createInfo.setSize(size);
+			createInfo.setType(type);
+			accel = device.createAccelerationStructureKHRUnique(createInfo);
+		}
+
+		void UpdateAddress(vk::Device device) {
 			vk::AccelerationStructureDeviceAddressInfoKHR addressInfo{};
 			addressInfo.setAccelerationStructure(*accel);
 			buffer.address = device.getAccelerationStructureAddressKHR(addressInfo);
 		}
 
+		size_t GetSize() {
+			return buffer.GetBufferSize();
+		}
+
 
 		void Release(vk::Device device) {
 			device.destroyAccelerationStructureKHR(*accel);
@@ -266,12 +349,8 @@ namespace Skhole {
 
 			vk::MemoryRequirements memRequirements = device.getImageMemoryRequirements(m_image);
 
-			vk::MemoryAllocateInfo allocInfo{};
-			allocInfo.setAllocationSize(memRequirements.size);
-			allocInfo.setMemoryTypeIndex(vkutils::getMemoryType(physicalDevice, memRequirements, properties));
-
-			m_imageMemory = device.allocateMemory(allocInfo);
-			device.bindImageMemory(m_image, m_imageMemory, 0);
+			m_allocation = GetMemoryAllocator().Allocate(physicalDevice, device, memRequirements, properties, MemoryLifetime::LongLived, true);
+			device.bindImageMemory(m_image, m_allocation.memory, m_allocation.offset);
 
 			vk::ImageViewCreateInfo viewInfo{};
 			viewInfo.setImage(m_image);
@@ -293,13 +372,13 @@ namespace Skhole {
 		void Release(vk::Device device) {
 			device.destroyImageView(m_imageView);
 			device.destroyImage(m_image);
-			device.freeMemory(m_imageMemory);
+			m_allocation.Free();
 		}
 
 	private:
 		vk::Image m_image;
 		vk::ImageView m_imageView;
-		vk::DeviceMemory m_imageMemory;
+		MemoryAllocation m_allocation;
 	};
 
 	inline void CopyBuffer(vk::Device device, Buffer& buffer, void* src, size_t size, size_t offset = 0) {
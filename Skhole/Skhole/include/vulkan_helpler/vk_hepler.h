@@ -48,15 +48,24 @@ namespace VkHelper {
 	struct BindingManager {
 		vk::DescriptorPool descriptorPool;
 		vk::DescriptorSetLayout descriptorSetLayout;
+
+		// Current set, written by Write* and bound by the renderers
 		vk::DescriptorSet descriptorSet;
 
+		// One set per frame in flight
+		std::vector<vk::DescriptorSet> descriptorSets;
+
 		std::vector<BindingLayoutElement> bindings;
 
-		void SetBindingLayout(vk::Device device, const std::vector<BindingLayoutElement>& binding, vk::DescriptorPoolCreateFlagBits frag) {
+		void SetBindingLayout(vk::Device device, const std::vector<BindingLayoutElement>& binding, vk::DescriptorPoolCreateFlagBits frag, uint32_t numSet = 1) {
 			bindings = binding;
 			SetLayout(device);
-			SetPool(frag, device);
-			SetDescriptorSet(device);
+			SetPool(frag, device, numSet);
+			SetDescriptorSet(device, numSet);
+		}
+
+		void SetFrame(uint32_t frameIndex) {
+			descriptorSet = descriptorSets[frameIndex];
 		}
 
 		void SetLayout(vk::Device device) {
@@ -75,11 +84,11 @@ namespace VkHelper {
 			descriptorSetLayout = device.createDescriptorSetLayout(createInfo);
 		}
 
-		void SetPool(vk::DescriptorPoolCreateFlagBits frag, vk::Device device) {
+		void SetPool(vk::DescriptorPoolCreateFlagBits frag, vk::Device device, uint32_t numSet = 1) {
 			std::vector<vk::DescriptorPoolSize> poolSizes;
 			std::map<vk::DescriptorType, uint32_t> typeMap;
 			for (auto& binding : bindings) {
-				typeMap[binding.descriptorType] += binding.descriptorCount;
+				typeMap[binding.descriptorType] += binding.descriptorCount * numSet;
 			}
 
 			for (auto& [type, count] : typeMap) {
@@ -88,19 +97,21 @@ namespace VkHelper {
 
 			vk::DescriptorPoolCreateInfo poolInfo = {};
 			poolInfo.setPoolSizes(poolSizes);
-			poolInfo.setMaxSets(1);
+			poolInfo.setMaxSets(numSet);
 			poolInfo.setFlags(frag);
 
 			descriptorPool = device.createDescriptorPool(poolInfo);
 		}
 
-		void SetDescriptorSet(vk::Device device) {
+		void SetDescriptorSet(vk::Device device, uint32_t numSet = 1) {
+			std::vector<vk::DescriptorSetLayout> layouts(numSet, descriptorSetLayout);
+
 			vk::DescriptorSetAllocateInfo allocInfo = {};
 			allocInfo.setDescriptorPool(descriptorPool);
-			allocInfo.setDescriptorSetCount(1);
-			allocInfo.setPSetLayouts(&descriptorSetLayout);
+			allocInfo.setSetLayouts(layouts);
 
-			descriptorSet = device.allocateDescriptorSets(allocInfo)[0];
+			descriptorSets = device.allocateDescriptorSets(allocInfo);
+			descriptorSet = descriptorSets[0];
 		}
 
 
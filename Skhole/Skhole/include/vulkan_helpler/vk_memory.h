@@ -0,0 +1,358 @@
+#pragma once
+#include <include.h>
+#include <vulkan_helpler/vkutils.hpp>
+
+#include <mutex>
+
+namespace Skhole {
+
+	enum class MemoryLifetime {
+		LongLived, // Free list blocks, freed ranges are reused
+		Transient, // Linear arena, a block is reset when all its allocations are freed. Scratch buffers freed right after use.
+	};
+
+	struct MemoryBlock;
+
+	// Range of a MemoryBlock, freed by the destructor like vk::UniqueDeviceMemory
+	struct MemoryAllocation {
+		MemoryAllocation() {};
+		~MemoryAllocation() { Free(); }
+
+		MemoryAllocation(const MemoryAllocation&) = delete;
+		MemoryAllocation& operator=(const MemoryAllocation&) = delete;
+
+		MemoryAllocation(MemoryAllocation&& other) noexcept {
+			*this = std::move(other);
+		}
+
+		MemoryAllocation& operator=(MemoryAllocation&& other) noexcept {
+			if (this != &other) {
+				Free();
+				block = other.block;
+				memory = other.memory;
+				offset = other.offset;
+				size = other.size;
+				mapped = other.mapped;
+				generation = other.generation;
+				other.block = nullptr;
+				other.memory = VK_NULL_HANDLE;
+				other.mapped = nullptr;
+			}
+			return *this;
+		}
+
+		inline void Free();
+
+		MemoryBlock* block = nullptr;
+		vk::DeviceMemory memory;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+		uint8_t* mapped = nullptr; // Host visible memory is mapped while the block lives
+		uint64_t generation = 0;
+	};
+
+	struct MemoryBlock {
+		struct FreeRange {
+			vk::DeviceSize offset;
+			vk::DeviceSize size;
+		};
+
+		vk::DeviceMemory memory;
+		vk::DeviceSize size = 0;
+		uint8_t* mapped = nullptr;
+
+		uint32_t memoryType = 0;
+		MemoryLifetime lifetime = MemoryLifetime::LongLived;
+		bool image = false;
+		bool dedicated = false;
+
+		std::vector<FreeRange> freeRanges; // LongLived, sorted by offset
+		vk::DeviceSize head = 0;           // Transient
+
+		uint32_t numAllocation = 0;
+		vk::DeviceSize usedSize = 0;
+	};
+
+	struct MemoryStatistics {
+		uint32_t numBlock = 0;
+		uint32_t numDedicatedBlock = 0;
+		uint32_t numAllocation = 0;
+		vk::DeviceSize blockSize = 0;
+		vk::DeviceSize usedSize = 0;
+		uint64_t numDeviceAllocation = 0; // vkAllocateMemory calls since the start
+	};
+
+	//-----------------------------------------------------
+	// Memory Allocator
+	//-----------------------------------------------------
+	// Buffers and images are placed in large blocks, one block list per memory type, lifetime and resource kind.
+	// Images have their own blocks, so buffers and optimal images never share a bufferImageGranularity page.
+	// Requests larger than half a block get a dedicated block.
+	class MemoryAllocator {
+	public:
+		MemoryAllocator() {};
+		~MemoryAllocator() {};
+
+		static constexpr vk::DeviceSize BLOCK_SIZE = 64ull << 20;
+		static constexpr vk::DeviceSize TRANSIENT_BLOCK_SIZE = 32ull << 20;
+
+		MemoryAllocation Allocate(
+			vk::PhysicalDevice physicalDevice,
+			vk::Device device,
+			const vk::MemoryRequirements& requirements,
+			vk::MemoryPropertyFlags memoryProperty,
+			MemoryLifetime lifetime,
+			bool image
+		) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (this->device != device) {
+				this->device = device;
+				memoryProperties = physicalDevice.getMemoryProperties();
+			}
+
+			uint32_t memoryType = vkutils::getMemoryType(physicalDevice, requirements, memoryProperty);
+
+			vk::DeviceSize blockSize = GetBlockSize(memoryType, lifetime);
+			vk::DeviceSize alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+
+			MemoryAllocation allocation;
+			vk::DeviceSize offset = 0;
+
+			if (requirements.size > blockSize / 2) {
+				MemoryBlock* block = CreateBlock(requirements.size, memoryType, lifetime, image, true);
+				block->freeRanges.clear();
+				block->head = requirements.size;
+				SetAllocation(allocation, block, 0, requirements.size);
+				return allocation;
+			}
+
+			for (auto& block : blocks) {
+				if (block->dedicated || block->memoryType != memoryType || block->lifetime != lifetime || block->image != image) continue;
+
+				if (SubAllocate(*block, requirements.size, alignment, offset)) {
+					SetAllocation(allocation, block.get(), offset, requirements.size);
+					return allocation;
+				}
+			}
+
+			MemoryBlock* block = CreateBlock(blockSize, memoryType, lifetime, image, false);
+			SubAllocate(*block, requirements.size, alignment, offset);
+			SetAllocation(allocation, block, offset, requirements.size);
+			return allocation;
+		}
+
+		void Free(MemoryAllocation& allocation) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// Blocks of an older generation were freed by Release
+			if (allocation.generation != generation) return;
+
+			MemoryBlock* block = allocation.block;
+			block->numAllocation--;
+			block->usedSize -= allocation.size;
+
+			if (block->lifetime == MemoryLifetime::LongLived && !block->dedicated) {
+				InsertFreeRange(*block, allocation.offset, allocation.size);
+			}
+
+			// The last allocation of an arena gives its range back
+			if (block->lifetime == MemoryLifetime::Transient && allocation.offset + allocation.size == block->head) {
+				block->head = allocation.offset;
+			}
+
+			if (block->numAllocation > 0) return;
+
+			if (block->lifetime == MemoryLifetime::Transient) {
+				block->head = 0;
+			}
+
+			// One empty block per list is kept, so a buffer created every frame does not allocate device memory each time
+			if (block->dedicated || HasEmptyBlock(*block)) {
+				DestroyBlock(block);
+			}
+		}
+
+		MemoryStatistics GetStatistics() {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			MemoryStatistics statistics;
+			for (auto& block : blocks) {
+				statistics.numBlock++;
+				if (block->dedicated) statistics.numDedicatedBlock++;
+				statistics.numAllocation += block->numAllocation;
+				statistics.blockSize += block->size;
+				statistics.usedSize += block->usedSize;
+			}
+			statistics.numDeviceAllocation = numDeviceAllocation;
+			return statistics;
+		}
+
+		void LogStatistics() {
+			MemoryStatistics statistics = GetStatistics();
+			SKHOLE_LOG("Device Memory : " << statistics.numAllocation << " allocations in "
+				<< statistics.numBlock << " blocks (" << statistics.numDedicatedBlock << " dedicated), "
+				<< double(statistics.usedSize) / (1024.0 * 1024.0) << " / " << double(statistics.blockSize) / (1024.0 * 1024.0) << " MB used, "
+				<< statistics.numDeviceAllocation << " vkAllocateMemory calls");
+		}
+
+		// Frees every block, call before the device is destroyed
+		void Release(vk::Device device) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (auto& block : blocks) {
+				if (block->mapped) device.unmapMemory(block->memory);
+				device.freeMemory(block->memory);
+			}
+			blocks.clear();
+
+			this->device = VK_NULL_HANDLE;
+			generation++;
+		}
+
+	private:
+		// vkutils::alignUp is 32-bit
+		static vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		vk::DeviceSize GetBlockSize(uint32_t memoryType, MemoryLifetime lifetime) {
+			vk::DeviceSize blockSize = lifetime == MemoryLifetime::Transient ? TRANSIENT_BLOCK_SIZE : BLOCK_SIZE;
+
+			// Small heaps (e.g. 256 MB host visible device memory) are not filled by a few blocks
+			vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+			return std::min(blockSize, heapSize / 8);
+		}
+
+		MemoryBlock* CreateBlock(vk::DeviceSize size, uint32_t memoryType, MemoryLifetime lifetime, bool image, bool dedicated) {
+			// Buffers with eShaderDeviceAddress may be placed in any block
+			vk::MemoryAllocateFlagsInfo allocateFlags{};
+			allocateFlags.flags = vk::MemoryAllocateFlagBits::eDeviceAddress;
+
+			vk::MemoryAllocateInfo allocateInfo{};
+			allocateInfo.setAllocationSize(size);
+			allocateInfo.setMemoryTypeIndex(memoryType);
+			allocateInfo.setPNext(&allocateFlags);
+
+			auto block = MakeUnq<MemoryBlock>();
+			block->memory = device.allocateMemory(allocateInfo);
+			block->size = size;
+			block->memoryType = memoryType;
+			block->lifetime = lifetime;
+			block->image = image;
+			block->dedicated = dedicated;
+			block->freeRanges.push_back({ 0, size });
+
+			if (memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+				block->mapped = static_cast<uint8_t*>(device.mapMemory(block->memory, 0, size));
+			}
+
+			numDeviceAllocation++;
+			blocks.push_back(std::move(block));
+			return blocks.back().get();
+		}
+
+		void DestroyBlock(MemoryBlock* block) {
+			if (block->mapped) device.unmapMemory(block->memory);
+			device.freeMemory(block->memory);
+
+			blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&](const UnqPtr<MemoryBlock>& b) { return b.get() == block; }));
+		}
+
+		// Another empty block of the same list
+		bool HasEmptyBlock(const MemoryBlock& block) {
+			for (auto& other : blocks) {
+				if (other.get() == &block || other->dedicated) continue;
+				if (other->memoryType == block.memoryType && other->lifetime == block.lifetime && other->image == block.image && other->numAllocation == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool SubAllocate(MemoryBlock& block, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset) {
+			if (block.lifetime == MemoryLifetime::Transient) {
+				vk::DeviceSize aligned = AlignUp(block.head, alignment);
+				if (aligned + size > block.size) return false;
+
+				offset = aligned;
+				block.head = aligned + size;
+				return true;
+			}
+
+			// First fit, the alignment padding stays free
+			for (size_t i = 0; i < block.freeRanges.size(); i++) {
+				auto range = block.freeRanges[i];
+				vk::DeviceSize aligned = AlignUp(range.offset, alignment);
+				if (aligned + size > range.offset + range.size) continue;
+
+				block.freeRanges.erase(block.freeRanges.begin() + i);
+
+				vk::DeviceSize end = aligned + size;
+				vk::DeviceSize rangeEnd = range.offset + range.size;
+				if (end < rangeEnd) {
+					block.freeRanges.insert(block.freeRanges.begin() + i, { end, rangeEnd - end });
+				}
+				if (range.offset < aligned) {
+					block.freeRanges.insert(block.freeRanges.begin() + i, { range.offset, aligned - range.offset });
+				}
+
+				offset = aligned;
+				return true;
+			}
+			return false;
+		}
+
+		// Merges with the neighbouring ranges
+		void InsertFreeRange(MemoryBlock& block, vk::DeviceSize offset, vk::DeviceSize size) {
+			auto& ranges = block.freeRanges;
+			auto next = std::lower_bound(ranges.begin(), ranges.end(), offset, [](const MemoryBlock::FreeRange& range, vk::DeviceSize o) {
+				return range.offset < o;
+				});
+			next = ranges.insert(next, { offset, size });
+
+			if (next + 1 != ranges.end() && next->offset + next->size == (next + 1)->offset) {
+				next->size += (next + 1)->size;
+				ranges.erase(next + 1);
+			}
+			if (next != ranges.begin() && (next - 1)->offset + (next - 1)->size == next->offset) {
+				(next - 1)->size += next->size;
+				ranges.erase(next);
+			}
+		}
+
+		void SetAllocation(MemoryAllocation& allocation, MemoryBlock* block, vk::DeviceSize offset, vk::DeviceSize size) {
+			block->numAllocation++;
+			block->usedSize += size;
+
+			allocation.block = block;
+			allocation.memory = block->memory;
+			allocation.offset = offset;
+			allocation.size = size;
+			allocation.mapped = block->mapped ? block->mapped + offset : nullptr;
+			allocation.generation = generation;
+		}
+
+		std::mutex mutex;
+		vk::Device device;
+		vk::PhysicalDeviceMemoryProperties memoryProperties;
+
+		std::vector<UnqPtr<MemoryBlock>> blocks;
+		uint64_t generation = 0;
+		uint64_t numDeviceAllocation = 0;
+	};
+
+	// One allocator for the device of the renderer
+	inline MemoryAllocator& GetMemoryAllocator() {
+		static MemoryAllocator allocator;
+		return allocator;
+	}
+
+	inline void MemoryAllocation::Free() {
+		if (block == nullptr) return;
+		GetMemoryAllocator().Free(*this);
+		block = nullptr;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+	}
+}
@@ -0,0 +1,319 @@
+#pragma once
+#include <include.h>
+#include <vulkan_helpler/vkutils.hpp>
+#include <vulkan_helpler/vk_buffer.h>
+
+#include <deque>
+#include <limits>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Upload Manager
+	//-----------------------------------------------------
+	// Buffer copies are queued by Enqueue and recorded into one command buffer by Flush.
+	// Adjacent ranges of the same buffer pair are merged into one region.
+	// Completion is tracked by a timeline semaphore, Flush returns the value signaled when its copies are done.
+	// Later submits on the same queue see the copies without waiting, the CPU only waits before rewriting staging memory.
+	// Stream writes through a ring of staging chunks, so large uploads need no staging buffer of their own size.
+	class UploadManager {
+	public:
+		UploadManager() {};
+		~UploadManager() {};
+
+		static constexpr vk::DeviceSize STAGING_CHUNK_SIZE = 16 << 20;
+		static constexpr uint32_t STAGING_CHUNK_COUNT = 4;
+
+		// queue may be a transfer queue of queueIndex, the buffers then need concurrent sharing with the render queue
+		void Init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t queueIndex, vk::Queue queue) {
+			this->physicalDevice = physicalDevice;
+			this->queue = queue;
+			commandPool = vkutils::createCommandPool(device, queueIndex);
+
+			vk::SemaphoreTypeCreateInfo typeInfo{};
+			typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline);
+			typeInfo.setInitialValue(0);
+
+			vk::SemaphoreCreateInfo createInfo{};
+			createInfo.setPNext(&typeInfo);
+			timeline = device.createSemaphoreUnique(createInfo);
+
+			submittedValue = 0;
+			stagingChunks.resize(STAGING_CHUNK_COUNT);
+		}
+
+		// Returns the timeline value the copy completes with
+		uint64_t Enqueue(vk::Buffer src, vk::Buffer dst, vk::DeviceSize srcOffset, vk::DeviceSize dstOffset, vk::DeviceSize size) {
+			if (size > 0) {
+				pendingCopies.push_back({ src, dst, srcOffset, dstOffset, size });
+			}
+			return submittedValue + 1;
+		}
+
+		uint64_t Enqueue(DeviceBuffer& buffer) {
+			return Enqueue(buffer.GetHostBuffer(), buffer.GetDeviceBuffer(), 0, 0, buffer.GetBufferSize());
+		}
+
+		uint64_t Enqueue(DeviceBuffer& buffer, vk::DeviceSize offset, vk::DeviceSize size) {
+			return Enqueue(buffer.GetHostBuffer(), buffer.GetDeviceBuffer(), offset, offset, size);
+		}
+
+		// Copies [dstOffset, dstOffset + size) of dst through the staging ring.
+		// writer(void* staging, offset, size) fills [offset, offset + size) of the range, pieces are cut at multiples of stride.
+		// When the ring is full the queued copies are flushed and the oldest chunk is waited for.
+		template <typename Writer>
+		uint64_t Stream(vk::Device device, vk::Buffer dst, vk::DeviceSize dstOffset, vk::DeviceSize size, vk::DeviceSize stride, Writer&& writer) {
+			vk::DeviceSize maxPieceSize = STAGING_CHUNK_SIZE / stride * stride;
+
+			vk::DeviceSize offset = 0;
+			while (offset < size) {
+				vk::DeviceSize pieceSize = std::min(size - offset, maxPieceSize);
+
+				vk::DeviceSize stagingOffset;
+				StagingChunk& chunk = AllocateStaging(device, pieceSize, stagingOffset);
+
+				writer(static_cast<uint8_t*>(chunk.map) + stagingOffset, offset, pieceSize);
+				Enqueue(*chunk.buffer.buffer, dst, stagingOffset, dstOffset + offset, pieceSize);
+
+				offset += pieceSize;
+			}
+			return submittedValue + 1;
+		}
+
+		uint64_t Write(vk::Device device, vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size) {
+			return Stream(device, dst, dstOffset, size, 1, [&](void* staging, vk::DeviceSize offset, vk::DeviceSize pieceSize) {
+				memcpy(staging, static_cast<const uint8_t*>(data) + offset, pieceSize);
+				});
+		}
+
+		// Submits the queued copies, returns the value of the last submit if nothing is queued
+		uint64_t Flush(vk::Device device) {
+			if (pendingCopies.empty()) return submittedValue;
+
+			vk::CommandBuffer commandBuffer = GetCommandBuffer(device);
+			commandBuffer.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+			// Work submitted before may still use the destinations
+			vk::MemoryBarrier barrier{};
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eMemoryWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eAllCommands,
+				vk::PipelineStageFlagBits::eTransfer,
+				{}, barrier, {}, {});
+
+			uint32_t numRegion = RecordCopies(commandBuffer);
+
+			// Later submits read the copied data
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eAllCommands,
+				{}, barrier, {}, {});
+
+			commandBuffer.end();
+
+			uint64_t signalValue = submittedValue + 1;
+
+			vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.setSignalSemaphoreValues(signalValue);
+
+			vk::SubmitInfo submitInfo{};
+			submitInfo.setCommandBuffers(commandBuffer);
+			submitInfo.setSignalSemaphores(*timeline);
+			submitInfo.setPNext(&timelineInfo);
+			queue.submit(submitInfo);
+
+			submissions.back().value = signalValue;
+			submittedValue = signalValue;
+
+			numFlushedCopy += pendingCopies.size();
+			numFlushedRegion += numRegion;
+			pendingCopies.clear();
+
+			return signalValue;
+		}
+
+		// Values not submitted yet return at once, their staging memory is not read until Flush
+		void Wait(vk::Device device, uint64_t value) {
+			value = std::min(value, submittedValue);
+			if (value == 0 || GetCompletedValue(device) >= value) return;
+
+			vk::SemaphoreWaitInfo waitInfo{};
+			waitInfo.setSemaphores(*timeline);
+			waitInfo.setValues(value);
+			if (device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+				std::cerr << "Failed to wait timeline semaphore.\n";
+				std::abort();
+			}
+		}
+
+		void WaitAll(vk::Device device) {
+			Wait(device, submittedValue);
+		}
+
+		uint64_t GetCompletedValue(vk::Device device) {
+			return device.getSemaphoreCounterValue(*timeline);
+		}
+
+		// Queued copies and the regions they were merged into, since Init
+		void GetStatistics(size_t& numCopy, size_t& numRegion) {
+			numCopy = numFlushedCopy;
+			numRegion = numFlushedRegion;
+		}
+
+		// Frees the staging chunks after the copies reading them, Stream allocates them again when needed
+		void ReleaseStaging(vk::Device device) {
+			Wait(device, Flush(device));
+
+			for (auto& chunk : stagingChunks) {
+				if (chunk.map) {
+					chunk.buffer.Unmap(device);
+					chunk.buffer.Release(device);
+				}
+				chunk = StagingChunk{};
+			}
+			currentChunk = 0;
+		}
+
+		// Copies not flushed are dropped, their buffers may be released already
+		void Release(vk::Device device) {
+			pendingCopies.clear();
+			ReleaseStaging(device);
+			stagingChunks.clear();
+
+			submissions.clear();
+			timeline.reset();
+			commandPool.reset();
+		}
+
+	private:
+		struct PendingCopy {
+			vk::Buffer src;
+			vk::Buffer dst;
+			vk::DeviceSize srcOffset;
+			vk::DeviceSize dstOffset;
+			vk::DeviceSize size;
+		};
+
+		struct Submission {
+			vk::UniqueCommandBuffer commandBuffer;
+			uint64_t value;
+		};
+
+		// Persistently mapped, value is the timeline value of the last copy reading it
+		struct StagingChunk {
+			Buffer buffer;
+			void* map = nullptr;
+			vk::DeviceSize used = 0;
+			uint64_t value = 0;
+		};
+
+		StagingChunk& AllocateStaging(vk::Device device, vk::DeviceSize size, vk::DeviceSize& offset) {
+			// 16 byte aligned for memcpy
+			vk::DeviceSize alignedUsed = (stagingChunks[currentChunk].used + 15) & ~vk::DeviceSize(15);
+
+			if (stagingChunks[currentChunk].map == nullptr || alignedUsed + size > STAGING_CHUNK_SIZE) {
+				if (stagingChunks[currentChunk].map != nullptr) {
+					currentChunk = (currentChunk + 1) % STAGING_CHUNK_COUNT;
+				}
+
+				auto& next = stagingChunks[currentChunk];
+				if (next.map == nullptr) {
+					next.buffer.Init(physicalDevice, device, STAGING_CHUNK_SIZE,
+						vk::BufferUsageFlagBits::eTransferSrc,
+						vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+					next.map = next.buffer.Map(device, 0, STAGING_CHUNK_SIZE);
+				}
+				else {
+					// Copies of the chunk may still be queued
+					if (next.value > submittedValue) Flush(device);
+					Wait(device, next.value);
+				}
+
+				next.used = 0;
+				alignedUsed = 0;
+			}
+
+			auto& chunk = stagingChunks[currentChunk];
+			offset = alignedUsed;
+			chunk.used = alignedUsed + size;
+			chunk.value = submittedValue + 1;
+			return chunk;
+		}
+
+		// Reuses the oldest command buffer once its submit completed
+		vk::CommandBuffer GetCommandBuffer(vk::Device device) {
+			if (!submissions.empty() && submissions.front().value <= GetCompletedValue(device)) {
+				Submission submission = std::move(submissions.front());
+				submissions.pop_front();
+				submissions.push_back(std::move(submission));
+			}
+			else {
+				submissions.push_back({ vkutils::createCommandBuffer(device, *commandPool), 0 });
+			}
+
+			auto& commandBuffer = *submissions.back().commandBuffer;
+			commandBuffer.reset({});
+			return commandBuffer;
+		}
+
+		// Sorts the copies by buffer pair and destination, merges ranges adjacent in both buffers
+		uint32_t RecordCopies(vk::CommandBuffer commandBuffer) {
+			std::stable_sort(pendingCopies.begin(), pendingCopies.end(), [](const PendingCopy& a, const PendingCopy& b) {
+				if (a.src != b.src) return a.src < b.src;
+				if (a.dst != b.dst) return a.dst < b.dst;
+				return a.dstOffset < b.dstOffset;
+				});
+
+			uint32_t numRegion = 0;
+			std::vector<vk::BufferCopy> regions;
+
+			size_t first = 0;
+			while (first < pendingCopies.size()) {
+				const auto& pair = pendingCopies[first];
+				regions.clear();
+
+				size_t last = first;
+				for (; last < pendingCopies.size() && pendingCopies[last].src == pair.src && pendingCopies[last].dst == pair.dst; last++) {
+					const auto& copy = pendingCopies[last];
+
+					if (!regions.empty()) {
+						auto& prev = regions.back();
+						vk::DeviceSize prevEnd = prev.dstOffset + prev.size;
+
+						// Same src -> dst shift and touching or overlapping ranges (a range written twice before Flush)
+						if (copy.srcOffset - copy.dstOffset == prev.srcOffset - prev.dstOffset && copy.dstOffset <= prevEnd) {
+							prev.size = std::max(prevEnd, copy.dstOffset + copy.size) - prev.dstOffset;
+							continue;
+						}
+					}
+
+					regions.push_back({ copy.srcOffset, copy.dstOffset, copy.size });
+				}
+
+				commandBuffer.copyBuffer(pair.src, pair.dst, regions);
+				numRegion += (uint32_t)regions.size();
+				first = last;
+			}
+
+			return numRegion;
+		}
+
+		vk::PhysicalDevice physicalDevice;
+		vk::Queue queue;
+		vk::UniqueCommandPool commandPool;
+		vk::UniqueSemaphore timeline;
+		uint64_t submittedValue = 0;
+
+		std::vector<PendingCopy> pendingCopies;
+		std::deque<Submission> submissions;
+
+		std::vector<StagingChunk> stagingChunks;
+		uint32_t currentChunk = 0;
+
+		size_t numFlushedCopy = 0;
+		size_t numFlushedRegion = 0;
+	};
+}
@@ -178,6 +178,14 @@ namespace vkutils {
 			.get<vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>();
 	}
 
+	inline auto getAccelerationStructureProps(vk::PhysicalDevice physicalDevice) {
+		auto deviceProperties = physicalDevice.getProperties2<
+			vk::PhysicalDeviceProperties2,
+			vk::PhysicalDeviceAccelerationStructurePropertiesKHR>();
+		return deviceProperties
+			.get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>();
+	}
+
 	inline void EnableFeatures(const std::vector<const char*>& extensions, std::vector<ShrPtr<void>>& extensionChain) {
 		for (auto& ex : extensions) {
 			if (ex == VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) {
@@ -199,6 +207,9 @@ namespace vkutils {
 			else if (ex == VK_EXT_SCALAR_BLOCK_LAYOUT_EXTENSION_NAME) {
 				extensionChain.push_back(MakeShr<vk::PhysicalDeviceScalarBlockLayoutFeatures>(VK_TRUE));
 			}
+			else if (ex == VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) {
+				extensionChain.push_back(MakeShr<vk::PhysicalDeviceTimelineSemaphoreFeatures>(VK_TRUE));
+			}
 		}
 
 		void* lastPNext = nullptr;
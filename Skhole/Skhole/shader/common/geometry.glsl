@@ -0,0 +1,126 @@
+// Geometry buffers, written by SceneBufferaManager::InitGeometryBuffer.
+// Positions are only used by the BLAS. Attributes are read from binding 4, indices from binding 5,
+// material ranges from binding 9.
+
+#define VERTEX_FORMAT_STANDARD 0
+#define VERTEX_FORMAT_COMPACT 1
+
+#define VERTEX_ATTRIBUTE_NONE 0xFFFFFFFFu
+
+#define INDEX_TYPE_UINT32 0
+#define INDEX_TYPE_UINT16 1
+
+struct GeometryData{
+	int vertexOffset;
+	int indexOffset;
+	uint vertexFormat;
+
+	uint indexOffsetByte;
+	uint indexType;
+
+	// Start of each stream in vertexAttrib, VERTEX_ATTRIBUTE_NONE if not stored
+	uint normalOffset;
+	uint texcoord0Offset;
+	uint texcoord1Offset;
+	uint colorOffset;
+
+	uint materialRangeOffset;
+	uint materialRangeCount;
+};
+
+struct MaterialRange{
+	uint firstPrim;
+	uint materialIndex;
+};
+
+layout(std430, binding = 4) buffer readonly vertexAttributeData{
+	uint vertexAttrib[];
+};
+
+layout(std430, binding = 5) buffer readonly indexData{
+	uint indexWords[];
+};
+
+uint FetchIndex(GeometryData geom, uint i){
+	if(geom.indexType == INDEX_TYPE_UINT16){
+		uint element = geom.indexOffsetByte / 2 + i;
+		return (indexWords[element >> 1] >> ((element & 1u) * 16u)) & 0xFFFFu;
+	}
+	return indexWords[geom.indexOffsetByte / 4 + i];
+}
+
+layout(std430, binding = 9) buffer readonly materialRangeData{
+	MaterialRange materialRanges[];
+};
+
+uvec3 FetchTriangle(GeometryData geom, uint primID){
+	return uvec3(FetchIndex(geom, primID * 3 + 0), FetchIndex(geom, primID * 3 + 1), FetchIndex(geom, primID * 3 + 2));
+}
+
+vec3 OctDecode(vec2 e){
+	vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec3 FetchNormal(GeometryData geom, uint index){
+	if(geom.normalOffset == VERTEX_ATTRIBUTE_NONE) return vec3(0.0, 1.0, 0.0);
+
+	if(geom.vertexFormat == VERTEX_FORMAT_COMPACT){
+		return OctDecode(unpackSnorm2x16(vertexAttrib[geom.normalOffset + index]));
+	}
+
+	uint offset = geom.normalOffset + index * 3;
+	return uintBitsToFloat(uvec3(vertexAttrib[offset], vertexAttrib[offset + 1], vertexAttrib[offset + 2]));
+}
+
+vec2 FetchTexcoord(GeometryData geom, uint streamOffset, uint index){
+	if(streamOffset == VERTEX_ATTRIBUTE_NONE) return vec2(0.0);
+
+	if(geom.vertexFormat == VERTEX_FORMAT_COMPACT){
+		return unpackHalf2x16(vertexAttrib[streamOffset + index]);
+	}
+
+	uint offset = streamOffset + index * 2;
+	return uintBitsToFloat(uvec2(vertexAttrib[offset], vertexAttrib[offset + 1]));
+}
+
+vec2 FetchTexcoord0(GeometryData geom, uint index){
+	return FetchTexcoord(geom, geom.texcoord0Offset, index);
+}
+
+vec2 FetchTexcoord1(GeometryData geom, uint index){
+	return FetchTexcoord(geom, geom.texcoord1Offset, index);
+}
+
+vec4 FetchColor(GeometryData geom, uint index){
+	if(geom.colorOffset == VERTEX_ATTRIBUTE_NONE) return vec4(1.0);
+
+	if(geom.vertexFormat == VERTEX_FORMAT_COMPACT){
+		return unpackUnorm4x8(vertexAttrib[geom.colorOffset + index]);
+	}
+
+	uint offset = geom.colorOffset + index * 4;
+	return uintBitsToFloat(uvec4(vertexAttrib[offset], vertexAttrib[offset + 1], vertexAttrib[offset + 2], vertexAttrib[offset + 3]));
+}
+
+// Material of the last range starting at or before primID
+uint FetchMaterialIndex(GeometryData geom, uint primID){
+	if(geom.materialRangeCount == 0) return 0;
+
+	uint low = 0;
+	uint high = geom.materialRangeCount - 1;
+	while(low < high){
+		uint mid = (low + high + 1) / 2;
+		if(materialRanges[geom.materialRangeOffset + mid].firstPrim <= primID){
+			low = mid;
+		}
+		else{
+			high = mid - 1;
+		}
+	}
+
+	return materialRanges[geom.materialRangeOffset + low].materialIndex;
+}
@@ -1,5 +1,8 @@
 #include <loader/gltf_loader.h>
 #include <common/filepath.h>
+#include <common/parallel.h>
+#include <common/mapped_file.h>
+#include <nlohmann/json.hpp>
 
 #include "tiny_gltf.h"
 
@@ -7,145 +10,614 @@
 namespace Skhole {
 
 	//-----------------------------------------------------
-	// Array Struct
+	// Buffer Table
 	//-----------------------------------------------------
-	struct IndexBufferArray
+	// Where the bytes of model.buffers[i] live.
+	// Usually model.buffers[i].data, for a mapped .glb the BIN chunk of the mapped file.
+	struct BufferRange {
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	using BufferTable = std::vector<BufferRange>;
+
+	inline BufferTable CreateBufferTable(const tinygltf::Model& model)
 	{
-		UnqPtr<IntArray<char>> dataChar = nullptr;
-		UnqPtr<IntArray<unsigned char>> dataUChar = nullptr;
-		UnqPtr<IntArray<short>> dataShort = nullptr;
-		UnqPtr<IntArray<unsigned short>> dataUShort = nullptr;
-		UnqPtr<IntArray<int>> dataInt = nullptr;
-		UnqPtr<IntArray<unsigned int>> dataUInt = nullptr;
-
-		IndexBufferArray(const unsigned char* dataPtr, const size_t count, const size_t byteStride, const int componentType) {
-			switch (componentType)
-			{
-			case TINYGLTF_COMPONENT_TYPE_BYTE:
-				dataChar = MakeUnq<IntArray<char>>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-				dataUChar = MakeUnq<IntArray<unsigned char>>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_SHORT:
-				dataShort = MakeUnq<IntArray<short>>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-				dataUShort = MakeUnq<IntArray<unsigned short>>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_INT:
-				dataInt = MakeUnq<IntArray<int>>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-				dataUChar = MakeUnq<IntArray<unsigned char>>(dataPtr, count, byteStride);
-				break;
-			default:
-				SKHOLE_UNIMPL("Not Compatible Index Format");
-				break;
-			}
-		}
-
-		uint32_t operator[](size_t index) const {
-			if (dataChar) return static_cast<uint32_t>((*dataChar)[index]);
-			if (dataUChar) return static_cast<uint32_t>((*dataUChar)[index]);
-			if (dataShort) return static_cast<uint32_t>((*dataShort)[index]);
-			if (dataUShort) return static_cast<uint32_t>((*dataUShort)[index]);
-			if (dataInt) return static_cast<uint32_t>((*dataInt)[index]);
-			if (dataUInt) return static_cast<uint32_t>((*dataUInt)[index]);
-			SKHOLE_UNIMPL("Not Compatible Index Format");
-			return 0;
+		BufferTable buffers(model.buffers.size());
+		for (size_t i = 0; i < model.buffers.size(); i++) {
+			buffers[i].data = model.buffers[i].data.data();
+			buffers[i].size = model.buffers[i].data.size();
 		}
+		return buffers;
+	}
+
+	//-----------------------------------------------------
+	// Accessor Decode
+	//-----------------------------------------------------
+	// Every accessor is resolved once and converted in bulk.
+	// The component type is dispatched once per accessor, not per element.
+	struct AccessorView {
+		const unsigned char* data = nullptr;
+		size_t count = 0;
+		size_t byteStride = 0;
+		int componentType = -1;
+		int numComponent = 0;
+		bool normalized = false;
 	};
 
-	struct Vector2Array {
-		UnqPtr<v2fArray> adapterFloat = nullptr;
-		UnqPtr<v2dArray> adapterDouble = nullptr;
-		Vector2Array(const unsigned char* dataPtr, const size_t count, const size_t byteStride, const int componentType)
+	inline bool GetAccessorView(const tinygltf::Model& model, const BufferTable& buffers, int accessorIndex, AccessorView& view)
+	{
+		if (accessorIndex < 0 || accessorIndex >= model.accessors.size()) return false;
+
+		const auto& accessor = model.accessors[accessorIndex];
+		if (accessor.bufferView < 0) return false;
+
+		const auto& bufferView = model.bufferViews[accessor.bufferView];
+		if (bufferView.buffer < 0 || bufferView.buffer >= buffers.size()) return false;
+		const auto& buffer = buffers[bufferView.buffer];
+
+		int byteStride = accessor.ByteStride(bufferView);
+		int numComponent = tinygltf::GetNumComponentsInType(accessor.type);
+		if (byteStride <= 0 || numComponent <= 0) return false;
+
+		view.data = buffer.data + bufferView.byteOffset + accessor.byteOffset;
+		view.count = accessor.count;
+		view.byteStride = byteStride;
+		view.componentType = accessor.componentType;
+		view.numComponent = numComponent;
+		view.normalized = accessor.normalized;
+
+		size_t lastByte = bufferView.byteOffset + accessor.byteOffset;
+		if (view.count > 0) {
+			lastByte += (view.count - 1) * view.byteStride + view.numComponent * tinygltf::GetComponentSizeInBytes(view.componentType);
+		}
+		if (lastByte > buffer.size) {
+			SKHOLE_ERROR("Accessor is out of buffer range");
+			return false;
+		}
+
+		return true;
+	}
+
+	template <typename T>
+	inline void WidenIndices(const AccessorView& view, uint32_t vertexOffset, uint32_t* dst)
+	{
+		if (view.byteStride == sizeof(T)) {
+			// Contiguous : plain loop the compiler can vectorize
+			const T* src = reinterpret_cast<const T*>(view.data);
+			if constexpr (sizeof(T) == sizeof(uint32_t)) {
+				if (vertexOffset == 0) {
+					memcpy(dst, src, view.count * sizeof(uint32_t));
+					return;
+				}
+			}
+			for (size_t i = 0; i < view.count; i++) {
+				dst[i] = static_cast<uint32_t>(src[i]) + vertexOffset;
+			}
+		}
+		else {
+			for (size_t i = 0; i < view.count; i++) {
+				T value;
+				memcpy(&value, view.data + i * view.byteStride, sizeof(T));
+				dst[i] = static_cast<uint32_t>(value) + vertexOffset;
+			}
+		}
+	}
+
+	inline bool DecodeIndices(const AccessorView& view, uint32_t vertexOffset, uint32_t* dst)
+	{
+		switch (view.componentType)
 		{
-			switch (componentType)
-			{
-			case TINYGLTF_COMPONENT_TYPE_FLOAT:
-				adapterFloat = MakeUnq<v2fArray>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_DOUBLE:
-				adapterDouble = MakeUnq<v2dArray>(dataPtr, count, byteStride);
-				break;
-			default:
-				break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			WidenIndices<uint8_t>(view, vertexOffset, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			WidenIndices<uint16_t>(view, vertexOffset, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			WidenIndices<uint32_t>(view, vertexOffset, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_BYTE:
+			WidenIndices<int8_t>(view, vertexOffset, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_SHORT:
+			WidenIndices<int16_t>(view, vertexOffset, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_INT:
+			WidenIndices<int32_t>(view, vertexOffset, dst);
+			return true;
+		default:
+			SKHOLE_ERROR("Not Compatible Index Format");
+			return false;
+		}
+	}
+
+	template <typename T, bool Normalized>
+	inline float ConvertComponent(T value)
+	{
+		if constexpr (Normalized) {
+			constexpr float scale = 1.0f / static_cast<float>(std::numeric_limits<T>::max());
+			if constexpr (std::is_signed_v<T>) {
+				return std::max(static_cast<float>(value) * scale, -1.0f);
+			}
+			else {
+				return static_cast<float>(value) * scale;
 			}
 		}
+		else {
+			return static_cast<float>(value);
+		}
+	}
 
-		v2f operator[](size_t index) const {
-			if (adapterFloat) return (*adapterFloat)[index];
-			if (adapterDouble) {
-				v2d f = (*adapterDouble)[index];
-				return { (float)f.x, (float)f.y };
+	// Write N floats per vertex at memberOffset of dst[i]
+	template <typename T, bool Normalized, uint32_t N>
+	inline void ConvertAttribute(const AccessorView& view, VertexData* dst, size_t memberOffset)
+	{
+		auto member = [dst, memberOffset](size_t i) {
+			return reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(dst + i) + memberOffset);
+			};
+
+		if (view.byteStride == sizeof(T) * N) {
+			const T* src = reinterpret_cast<const T*>(view.data);
+			for (size_t i = 0; i < view.count; i++) {
+				float* out = member(i);
+				for (uint32_t c = 0; c < N; c++) {
+					out[c] = ConvertComponent<T, Normalized>(src[i * N + c]);
+				}
 			}
-			SKHOLE_UNIMPL("Not Compatible Vector2 Format");
-			return v2f();
 		}
-	};
+		else {
+			for (size_t i = 0; i < view.count; i++) {
+				T value[N];
+				memcpy(value, view.data + i * view.byteStride, sizeof(T) * N);
+				float* out = member(i);
+				for (uint32_t c = 0; c < N; c++) {
+					out[c] = ConvertComponent<T, Normalized>(value[c]);
+				}
+			}
+		}
+	}
 
-	struct Vector3Array {
-		UnqPtr<v3fArray> adapterFloat = nullptr;
-		UnqPtr<v3dArray> adapterDouble = nullptr;
+	template <uint32_t N>
+	inline bool DecodeAttribute(const AccessorView& view, VertexData* dst, size_t memberOffset)
+	{
+		if (view.numComponent < N) {
+			SKHOLE_ERROR("Not Compatible Attribute Type");
+			return false;
+		}
 
-		Vector3Array(const unsigned char* dataPtr, const size_t count, const size_t byteStride, const int componentType)
+		switch (view.componentType)
 		{
-			switch (componentType)
-			{
-			case TINYGLTF_COMPONENT_TYPE_FLOAT:
-				adapterFloat = MakeUnq<v3fArray>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_DOUBLE:
-				adapterDouble = MakeUnq<v3dArray>(dataPtr, count, byteStride);
-				break;
-			default:
-				break;
+		case TINYGLTF_COMPONENT_TYPE_FLOAT:
+			ConvertAttribute<float, false, N>(view, dst, memberOffset);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+			ConvertAttribute<double, false, N>(view, dst, memberOffset);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			if (view.normalized) ConvertAttribute<uint8_t, true, N>(view, dst, memberOffset);
+			else ConvertAttribute<uint8_t, false, N>(view, dst, memberOffset);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			if (view.normalized) ConvertAttribute<uint16_t, true, N>(view, dst, memberOffset);
+			else ConvertAttribute<uint16_t, false, N>(view, dst, memberOffset);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_BYTE:
+			if (view.normalized) ConvertAttribute<int8_t, true, N>(view, dst, memberOffset);
+			else ConvertAttribute<int8_t, false, N>(view, dst, memberOffset);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_SHORT:
+			if (view.normalized) ConvertAttribute<int16_t, true, N>(view, dst, memberOffset);
+			else ConvertAttribute<int16_t, false, N>(view, dst, memberOffset);
+			return true;
+		default:
+			SKHOLE_ERROR("Not Compatible Attribute Format");
+			return false;
+		}
+	}
+
+	// JOINTS_0 : unsigned byte or unsigned short
+	template <typename T>
+	inline void ConvertJoints(const AccessorView& view, SkinVertex* dst)
+	{
+		for (size_t i = 0; i < view.count; i++) {
+			T value[4];
+			memcpy(value, view.data + i * view.byteStride, sizeof(T) * 4);
+			for (uint32_t c = 0; c < 4; c++) {
+				dst[i].joints[c] = static_cast<uint16_t>(value[c]);
 			}
 		}
+	}
 
-		v3f operator[](size_t index) const {
-			if (adapterFloat) return (*adapterFloat)[index];
-			if (adapterDouble) {
-				v3d f = (*adapterDouble)[index];
-				return { (float)f.x, (float)f.y, (float)f.z };
+	inline bool DecodeJoints(const AccessorView& view, SkinVertex* dst)
+	{
+		if (view.numComponent < 4) {
+			SKHOLE_ERROR("Not Compatible Joints Type");
+			return false;
+		}
+
+		switch (view.componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			ConvertJoints<uint8_t>(view, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			ConvertJoints<uint16_t>(view, dst);
+			return true;
+		default:
+			SKHOLE_ERROR("Not Compatible Joints Format");
+			return false;
+		}
+	}
+
+	// WEIGHTS_0 : float, normalized unsigned byte or short. Renormalized to sum 1.
+	template <typename T, bool Normalized>
+	inline void ConvertWeights(const AccessorView& view, SkinVertex* dst)
+	{
+		for (size_t i = 0; i < view.count; i++) {
+			T value[4];
+			memcpy(value, view.data + i * view.byteStride, sizeof(T) * 4);
+
+			float sum = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				dst[i].weights[c] = ConvertComponent<T, Normalized>(value[c]);
+				sum += dst[i].weights[c];
+			}
+
+			if (sum > 0.0f) {
+				for (uint32_t c = 0; c < 4; c++) {
+					dst[i].weights[c] /= sum;
+				}
 			}
-			SKHOLE_UNIMPL("Not Compatible Vector3 Format");
-			return v3f();
 		}
+	}
+
+	inline bool DecodeWeights(const AccessorView& view, SkinVertex* dst)
+	{
+		if (view.numComponent < 4) {
+			SKHOLE_ERROR("Not Compatible Weights Type");
+			return false;
+		}
+
+		switch (view.componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_FLOAT:
+			ConvertWeights<float, false>(view, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			ConvertWeights<uint8_t, true>(view, dst);
+			return true;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			ConvertWeights<uint16_t, true>(view, dst);
+			return true;
+		default:
+			SKHOLE_ERROR("Not Compatible Weights Format");
+			return false;
+		}
+	}
+
+	inline VertexData GetDefaultVertex()
+	{
+		VertexData vertex;
+		vertex.position = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		vertex.normal = vec4(0.0f, 1.0f, 0.0f, 0.0f);
+		vertex.texcoord0[0] = 1.0f;
+		vertex.texcoord0[1] = 1.0f;
+		vertex.texcoord1[0] = 1.0f;
+		vertex.texcoord1[1] = 1.0f;
+		vertex.color = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+		return vertex;
+	}
+
+	// One primitive, written to its own range of the mesh geometry
+	struct PrimitiveDecodeJob {
+		uint32_t meshIndex;
+		uint32_t primIndex;
+		size_t vertexOffset;
+		size_t vertexCount;
+		size_t indexOffset;
+		size_t indexCount;
+		size_t primOffset; // First triangle in m_materialIndices
 	};
 
-	struct Vector4Array {
-		UnqPtr<v4fArray> adapterFloat = nullptr;
-		UnqPtr<v4dArray> adapterDouble = nullptr;
+	// Pre-size the geometry of a mesh and list the ranges of its primitives
+	inline void PrepareMesh(const tinygltf::Model& model, uint32_t meshIndex, Geometry& geometry, std::vector<PrimitiveDecodeJob>& jobs)
+	{
+		const auto& mesh = model.meshes[meshIndex];
+
+		size_t numVertex = 0;
+		size_t numIndex = 0;
+		size_t numPrim = 0;
+		bool skinned = false;
+		for (uint32_t p = 0; p < mesh.primitives.size(); p++) {
+			const auto& prim = mesh.primitives[p];
+			auto position = prim.attributes.find("POSITION");
+			if (position == prim.attributes.end()) continue;
+
+			// Only triangle lists are supported, -1 is the default of tinygltf
+			if (prim.mode != TINYGLTF_MODE_TRIANGLES && prim.mode != -1) {
+				SKHOLE_WARN("Primitive " << p << " of mesh " << mesh.name << " is skipped, mode " << prim.mode << " is not triangles");
+				continue;
+			}
+
+			if (position->second < 0 || position->second >= model.accessors.size() || prim.indices >= (int)model.accessors.size()) {
+				SKHOLE_WARN("Primitive " << p << " of mesh " << mesh.name << " is skipped, invalid accessor");
+				continue;
+			}
+
+			size_t vertexCount = model.accessors[position->second].count;
+			size_t indexCount = (prim.indices >= 0) ? model.accessors[prim.indices].count : vertexCount;
+			if (indexCount % 3 != 0) {
+				SKHOLE_WARN("Primitive " << p << " of mesh " << mesh.name << " is skipped, index count is not a multiple of 3");
+				continue;
+			}
+
+			skinned |= prim.attributes.count("JOINTS_0") > 0 && prim.attributes.count("WEIGHTS_0") > 0;
+
+			PrimitiveDecodeJob job;
+			job.meshIndex = meshIndex;
+			job.primIndex = p;
+			job.vertexOffset = numVertex;
+			job.vertexCount = vertexCount;
+			job.indexOffset = numIndex;
+			job.indexCount = indexCount;
+			job.primOffset = numPrim;
+			jobs.push_back(job);
+
+			numVertex += job.vertexCount;
+			numIndex += job.indexCount;
+			numPrim += job.indexCount / 3;
+		}
+
+		geometry.m_vertices.resize(numVertex);
+		geometry.m_indices.resize(numIndex);
+		geometry.m_materialIndices.resize(numPrim);
+		if (skinned) geometry.m_skinVertices.resize(numVertex);
+	}
+
+	inline bool DecodePrimitive(const tinygltf::Model& model, const BufferTable& buffers, const PrimitiveDecodeJob& job, bool haveMaterial, Geometry& geometry)
+	{
+		const auto& prim = model.meshes[job.meshIndex].primitives[job.primIndex];
+		const size_t vertexOffset = job.vertexOffset;
+		const size_t vertexCount = job.vertexCount;
+		const size_t indexOffset = job.indexOffset;
+
+		VertexData* vertices = geometry.m_vertices.data() + vertexOffset;
+		std::fill(vertices, vertices + vertexCount, GetDefaultVertex());
+
+		// Primitives without weights follow joint 0
+		SkinVertex* skinVertices = nullptr;
+		if (!geometry.m_skinVertices.empty()) {
+			skinVertices = geometry.m_skinVertices.data() + vertexOffset;
+			std::fill(skinVertices, skinVertices + vertexCount, SkinVertex{ { 0, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } });
+		}
+
+		// Index
+		if (prim.indices >= 0) {
+			AccessorView indexView;
+			if (!GetAccessorView(model, buffers, prim.indices, indexView)) return false;
+			if (!DecodeIndices(indexView, static_cast<uint32_t>(vertexOffset), geometry.m_indices.data() + indexOffset)) return false;
+		}
+		else {
+			for (size_t i = 0; i < vertexCount; i++) {
+				geometry.m_indices[indexOffset + i] = static_cast<uint32_t>(vertexOffset + i);
+			}
+		}
 
-		Vector4Array(const unsigned char* dataPtr, const size_t count, const size_t byteStride, const int componentType)
+		// Attribute
+		for (const auto& attribute : prim.attributes)
 		{
-			switch (componentType)
-			{
-			case TINYGLTF_COMPONENT_TYPE_FLOAT:
-				adapterFloat = MakeUnq<v4fArray>(dataPtr, count, byteStride);
-				break;
-			case TINYGLTF_COMPONENT_TYPE_DOUBLE:
-				adapterDouble = MakeUnq<v4dArray>(dataPtr, count, byteStride);
-				break;
-			default:
-				break;
+			AccessorView view;
+			if (!GetAccessorView(model, buffers, attribute.second, view)) continue;
+			if (view.count != vertexCount) {
+				SKHOLE_WARN("Attribute count mismatch : " + attribute.first);
+				continue;
+			}
+
+			bool result = true;
+			if (attribute.first == "POSITION") {
+				result = DecodeAttribute<3>(view, vertices, offsetof(VertexData, position));
+			}
+			else if (attribute.first == "NORMAL") {
+				result = DecodeAttribute<3>(view, vertices, offsetof(VertexData, normal));
+			}
+			else if (attribute.first == "TEXCOORD_0") {
+				result = DecodeAttribute<2>(view, vertices, offsetof(VertexData, texcoord0));
+			}
+			else if (attribute.first == "TEXCOORD_1") {
+				result = DecodeAttribute<2>(view, vertices, offsetof(VertexData, texcoord1));
+			}
+			else if (attribute.first == "COLOR_0") {
+				if (view.numComponent == 3) result = DecodeAttribute<3>(view, vertices, offsetof(VertexData, color));
+				else result = DecodeAttribute<4>(view, vertices, offsetof(VertexData, color));
 			}
+			else if (attribute.first == "JOINTS_0" && skinVertices) {
+				result = DecodeJoints(view, skinVertices);
+			}
+			else if (attribute.first == "WEIGHTS_0" && skinVertices) {
+				result = DecodeWeights(view, skinVertices);
+			}
+
+			if (!result) return false;
+		} // end of attribute loop
+
+		//Material Index
+		uint32_t materialIndex = (haveMaterial && prim.material >= 0) ? prim.material : 0;
+		std::fill(
+			geometry.m_materialIndices.begin() + job.primOffset,
+			geometry.m_materialIndices.begin() + job.primOffset + job.indexCount / 3,
+			materialIndex
+		);
+
+		return true;
+	}
+
+	// Decode every mesh into its own geometry.
+	// Primitives of all meshes are decoded in parallel, each into a fixed range,
+	// so the result does not depend on the scheduling.
+	inline bool DecodeMeshes(const tinygltf::Model& model, const BufferTable& buffers, bool haveMaterial, std::vector<ShrPtr<Geometry>>& geometries)
+	{
+		const size_t numMesh = model.meshes.size();
+		geometries.resize(numMesh);
+
+		std::vector<PrimitiveDecodeJob> jobs;
+		for (uint32_t m = 0; m < numMesh; m++) {
+			geometries[m] = MakeShr<Geometry>();
+			PrepareMesh(model, m, *geometries[m], jobs);
 		}
 
-		v4f operator[](size_t index) const {
-			if (adapterFloat) return (*adapterFloat)[index];
-			if (adapterDouble) {
-				v4d f = (*adapterDouble)[index];
-				return { (float)f.x, (float)f.y, (float)f.z, (float)f.w };
+		// Large primitives first for better balance
+		std::stable_sort(jobs.begin(), jobs.end(), [](const PrimitiveDecodeJob& a, const PrimitiveDecodeJob& b) {
+			return a.vertexCount + a.indexCount > b.vertexCount + b.indexCount;
+			});
+
+		std::vector<uint8_t> jobResult(jobs.size(), 0);
+		ParallelForDynamic(jobs.size(), [&](size_t i) {
+			const auto& job = jobs[i];
+			jobResult[i] = DecodePrimitive(model, buffers, job, haveMaterial, *geometries[job.meshIndex]) ? 1 : 0;
+			});
+
+		for (size_t i = 0; i < jobs.size(); i++) {
+			if (!jobResult[i]) {
+				SKHOLE_ERROR("Failed to decode mesh : " + model.meshes[jobs[i].meshIndex].name);
+				return false;
 			}
-			SKHOLE_UNIMPL("Not Compatible Vector4 Format");
-			return v4f();
 		}
+
+		return true;
+	}
+
+	//-----------------------------------------------------
+	// Mapped GLB
+	//-----------------------------------------------------
+	struct GLBHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t length;
 	};
 
+	struct GLBChunkHeader {
+		uint32_t length;
+		uint32_t type;
+	};
+
+	constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942; // "BIN\0"
+	constexpr uint32_t GLB_STUB_BIN_SIZE = 4;
+
+	// Parse a mapped .glb without copying its BIN chunk.
+	// tinygltf only gets the JSON chunk and a 4 byte stand-in for the embedded buffer,
+	// the accessors then read the mapped BIN chunk through the buffer table.
+	inline bool LoadMappedGLB(
+		tinygltf::TinyGLTF& loader,
+		const std::string& filename,
+		const MappedFile& file,
+		tinygltf::Model& model,
+		BufferTable& buffers,
+		std::string& err,
+		std::string& warn
+	)
+	{
+		const uint8_t* data = file.GetData();
+		const size_t size = file.GetSize();
+
+		if (size < sizeof(GLBHeader) + sizeof(GLBChunkHeader)) return false;
+
+		GLBHeader header;
+		memcpy(&header, data, sizeof(header));
+		if (header.magic != GLB_MAGIC || header.version != 2 || header.length > size) return false;
+
+		const char* jsonChunk = nullptr;
+		size_t jsonSize = 0;
+		const unsigned char* binChunk = nullptr;
+		size_t binSize = 0;
+
+		size_t offset = sizeof(GLBHeader);
+		while (offset + sizeof(GLBChunkHeader) <= header.length) {
+			GLBChunkHeader chunk;
+			memcpy(&chunk, data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+
+			if (chunk.length > header.length - offset) return false;
+
+			if (chunk.type == GLB_CHUNK_JSON && jsonChunk == nullptr) {
+				jsonChunk = reinterpret_cast<const char*>(data + offset);
+				jsonSize = chunk.length;
+			}
+			else if (chunk.type == GLB_CHUNK_BIN && binChunk == nullptr) {
+				binChunk = data + offset;
+				binSize = chunk.length;
+			}
+
+			offset += (size_t(chunk.length) + 3) & ~size_t(3);
+		}
+
+		if (jsonChunk == nullptr) return false;
+
+		nlohmann::json gltfJs = nlohmann::json::parse(jsonChunk, jsonChunk + jsonSize, nullptr, false);
+		if (gltfJs.is_discarded()) return false;
+
+		// The buffer without uri is the BIN chunk
+		int binBuffer = -1;
+		if (binChunk != nullptr && gltfJs.contains("buffers")) {
+			auto& buffersJs = gltfJs["buffers"];
+			for (size_t i = 0; i < buffersJs.size(); i++) {
+				if (!buffersJs[i].contains("uri")) {
+					binBuffer = static_cast<int>(i);
+					buffersJs[i]["byteLength"] = GLB_STUB_BIN_SIZE;
+					break;
+				}
+			}
+		}
+
+		// Textures are not loaded yet (TODO Texture), and embedded images would point into the stand-in buffer
+		gltfJs.erase("images");
+		gltfJs.erase("textures");
+		gltfJs.erase("samplers");
+
+		std::string json = gltfJs.dump();
+		json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+		// Small GLB : [Header][JSON][BIN stand-in]
+		std::vector<unsigned char> glb;
+		auto append = [&glb](const void* src, size_t length) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(src);
+			glb.insert(glb.end(), bytes, bytes + length);
+			};
+
+		GLBHeader stubHeader;
+		stubHeader.magic = GLB_MAGIC;
+		stubHeader.version = 2;
+		stubHeader.length = static_cast<uint32_t>(sizeof(GLBHeader) + sizeof(GLBChunkHeader) + json.size()
+			+ (binBuffer >= 0 ? sizeof(GLBChunkHeader) + GLB_STUB_BIN_SIZE : 0));
+		append(&stubHeader, sizeof(stubHeader));
+
+		GLBChunkHeader jsonHeader = { static_cast<uint32_t>(json.size()), GLB_CHUNK_JSON };
+		append(&jsonHeader, sizeof(jsonHeader));
+		append(json.data(), json.size());
+
+		if (binBuffer >= 0) {
+			GLBChunkHeader binHeader = { GLB_STUB_BIN_SIZE, GLB_CHUNK_BIN };
+			const uint8_t stub[GLB_STUB_BIN_SIZE] = {};
+			append(&binHeader, sizeof(binHeader));
+			append(stub, GLB_STUB_BIN_SIZE);
+		}
+
+		std::string baseDir = std::filesystem::path(filename).parent_path().string();
+		if (!loader.LoadBinaryFromMemory(&model, &err, &warn, glb.data(), static_cast<unsigned int>(glb.size()), baseDir)) {
+			return false;
+		}
+
+		buffers = CreateBufferTable(model);
+		if (binBuffer >= 0 && binBuffer < buffers.size()) {
+			buffers[binBuffer].data = binChunk;
+			buffers[binBuffer].size = binSize;
+		}
+
+		return true;
+	}
+
 	//-----------------------------------------------------
 	// GLTF Loader
 	//-----------------------------------------------------
@@ -154,7 +626,8 @@ namespace Skhole {
 		std::vector<ShrPtr<Object>>& inObjects,
 		std::vector<ShrPtr<Geometry>>& inGeometies,
 		std::vector<ShrPtr<BasicMaterial>>& inBasicMaterials,
-		std::vector<ShrPtr<Texture>>& inTextures
+		std::vector<ShrPtr<Texture>>& inTextures,
+		std::vector<ShrPtr<Skin>>& inSkins
 	)
 	{
 		tinygltf::Model model;
@@ -166,14 +639,37 @@ namespace Skhole {
 		std::string ext;
 		GetFileExtension(filename, ext);
 
-		bool ret;
+		// Keeps the mapped BIN chunk alive while decoding
+		MappedFile glbFile;
+		BufferTable buffers;
+
+		bool ret = false;
+		bool mapped = false;
 		if (ext == "glb") {
-			ret = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
+			if (glbFile.Open(filename)) {
+				mapped = LoadMappedGLB(loader, filename, glbFile, model, buffers, err, warn);
+			}
+
+			if (mapped) {
+				ret = true;
+			}
+			else {
+				SKHOLE_LOG("Mapped GLB load failed, read whole file");
+				glbFile.Close();
+				model = tinygltf::Model();
+				err.clear();
+				warn.clear();
+				ret = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
+			}
 		}
 		else {
 			ret = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
 		}
 
+		if (ret && !mapped) {
+			buffers = CreateBufferTable(model);
+		}
+
 		if (!warn.empty()) {
 			SKHOLE_WARN(warn);
 		}
@@ -191,148 +687,28 @@ namespace Skhole {
 		inGeometies.clear();
 		inBasicMaterials.clear();
 		inTextures.clear();
+		inSkins.clear();
 
 		bool haveMaterial = model.materials.size() > 0;
 
 		//-----------------------------------------------------
 		// Load Mesh
 		//-----------------------------------------------------
-		auto& modelMesh = model.meshes;
-		for (const auto& mesh : modelMesh) {
-			auto geometry = MakeShr<Geometry>();
-
-			std::vector<vec3> position;
-			std::vector<vec3> normal;
-			std::vector<vec2> texcoord0;
-			std::vector<vec2> texcoord1;
-			std::vector<vec4> color;
-
-			uint32_t indexOffset = 0;
-
-			for (const auto& prim : mesh.primitives)
-			{
-				const auto& idxAccessor = model.accessors[prim.indices];
-				const auto& idxBufferView = model.bufferViews[idxAccessor.bufferView];
-				const auto& idxByteBuffer = model.buffers[idxBufferView.buffer];
-
-				const auto dataPtr = idxByteBuffer.data.data() + idxBufferView.byteOffset + idxAccessor.byteOffset;
-				const auto count = idxAccessor.count;
-				const auto byteStride = idxAccessor.ByteStride(idxBufferView);
-
-
-				IndexBufferArray indexArray(dataPtr, count, byteStride, idxAccessor.componentType);
-				for (size_t i = 0; i < count; i++)
-				{
-					auto idx = indexArray[i];
-					geometry->m_indices.push_back(idx + indexOffset);
-				}
-
-
-				uint32_t vertexCount = 0;
-
-				for (const auto& attribute : prim.attributes)
-				{
-					const auto& accessor = model.accessors[attribute.second];
-					const auto& bufferView = model.bufferViews[accessor.bufferView];
-					const auto& byteBuffer = model.buffers[bufferView.buffer];
-
-					const auto dataPtr = byteBuffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
-					const auto count = accessor.count;
-					const auto byteStride = accessor.ByteStride(bufferView);
-
-					if (attribute.first == "POSITION") {
-						Vector3Array positionArray(dataPtr, count, byteStride, accessor.componentType);
-						for (size_t i = 0; i < count; i++)
-						{
-							auto pos = positionArray[i];
-							position.push_back({ pos.x, pos.y, pos.z });
-						}
-
-						vertexCount = count;
-					}
-
-					if (attribute.first == "NORMAL") {
-						Vector3Array normalArray(dataPtr, count, byteStride, accessor.componentType);
-						for (size_t i = 0; i < count; i++)
-						{
-							auto n = normalArray[i];
-							normal.push_back({ n.x, n.y, n.z });
-						}
-					}
-
-					if (attribute.first == "TEXCOORD_0") {
-						Vector2Array texcoord0Array(dataPtr, count, byteStride, accessor.componentType);
-						for (size_t i = 0; i < count; i++)
-						{
-							auto t = texcoord0Array[i];
-							texcoord0.push_back({ t.x, t.y });
-						}
-					}
-
-					if (attribute.first == "TEXCOORD_1") {
-						Vector2Array texcoord1Array(dataPtr, count, byteStride, accessor.componentType);
-						for (size_t i = 0; i < count; i++)
-						{
-							auto t = texcoord1Array[i];
-							texcoord1.push_back({ t.x, t.y });
-						}
-					}
-
-					if (attribute.first == "COLOR_0") {
-						Vector4Array colorArray(dataPtr, count, byteStride, accessor.componentType);
-						for (size_t i = 0; i < count; i++)
-						{
-							auto c = colorArray[i];
-							color.push_back({ c.x, c.y, c.z, c.w });
-						}
-					}
-				} // end of attribute loop
-
-				indexOffset += vertexCount;
-
-				//Material Index
-				for (int i = 0; i < count / 3; i++) {
-					if (haveMaterial)
-						geometry->m_materialIndices.push_back(prim.material);
-					else
-						geometry->m_materialIndices.push_back(0);
-				}
-
-			}// end of primitive loop
-
-			auto& geometryVertex = geometry->m_vertices;
-			SKHOLE_ASSERT(position.size() > 0);
-			for (size_t i = 0; i < position.size(); i++)
-			{
-				VertexData vertex;
-				vertex.position = vec4(position[i], 1.0);
-				if (normal.size() >= i + 1) vertex.normal = vec4(normal[i], 0.0);
-				else vertex.normal = vec4(0, 1, 0, 0);
-				if (texcoord0.size() >= i + 1) {
-					vertex.texcoord0[0] = texcoord0[i].x;
-					vertex.texcoord0[1] = texcoord0[i].y;
-				}
-				else {
-					vertex.texcoord0[0] = 1.0f;
-					vertex.texcoord0[1] = 1.0f;
-				}
-				if (texcoord1.size() >= i + 1) {
-					vertex.texcoord1[0] = texcoord1[i].x;
-					vertex.texcoord1[1] = texcoord1[i].y;
-				}
-				else {
-					vertex.texcoord1[0] = 1.0f;
-					vertex.texcoord1[1] = 1.0f;
-				}
-				if (color.size() >= i + 1) vertex.color = color[i];
-				else vertex.color = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+		std::vector<ShrPtr<Geometry>> meshGeometries;
+		if (!DecodeMeshes(model, buffers, haveMaterial, meshGeometries)) {
+			return false;
+		}
 
-				geometryVertex.push_back(vertex);
+		// Meshes whose primitives were all skipped are dropped, their nodes become transform only instances
+		std::vector<int> meshToGeometry(meshGeometries.size(), -1);
+		for (size_t m = 0; m < meshGeometries.size(); m++) {
+			if (meshGeometries[m]->m_vertices.empty()) {
+				SKHOLE_WARN("Mesh " << m << " (" << model.meshes[m].name << ") has no triangle primitive and is skipped");
+				continue;
 			}
-
-			inGeometies.push_back(geometry);
-
-		}// end of mesh loop
+			meshToGeometry[m] = static_cast<int>(inGeometies.size());
+			inGeometies.push_back(meshGeometries[m]);
+		}
 
 		//-----------------------------------------------------
 		// Load Object
@@ -341,14 +717,37 @@ namespace Skhole {
 		for (const auto& node : modelNode)
 		{
 			ShrPtr<Object> object;
+			uint32_t objectIndex = static_cast<uint32_t>(inObjects.size());
+
+			int geometryIndex = (node.mesh >= 0 && node.mesh < meshToGeometry.size()) ? meshToGeometry[node.mesh] : -1;
 
-			if (node.mesh != -1)
+			if (geometryIndex != -1)
 			{
 				ShrPtr<Instance> instance = MakeShr<Instance>();
-				instance->geometryIndex = node.mesh;
+				instance->geometryIndex = geometryIndex;
+
+				if (node.skin != -1) {
+					auto& geometry = inGeometies[geometryIndex];
+					if (geometry->m_skinVertices.empty()) {
+						SKHOLE_WARN("Skinned mesh without JOINTS_0 / WEIGHTS_0 : " + node.name);
+					}
+					else if (geometry->skinIndex.has_value()) {
+						SKHOLE_WARN("Mesh is skinned by several nodes, the first one is used : " + node.name);
+					}
+					else {
+						geometry->skinIndex = node.skin;
+						geometry->skinObjectIndex = objectIndex;
+						geometry->useAnimation = true;
+					}
+				}
 
 				object = instance;
 			}
+			else if (node.mesh != -1)
+			{
+				// Mesh without triangles
+				object = MakeShr<Instance>();
+			}
 			else if (node.skin != -1)
 			{
 				SKHOLE_UNIMPL("Not Comaptible Skin");
@@ -365,6 +764,11 @@ namespace Skhole {
 			{
 				SKHOLE_UNIMPL("Not Comaptible Light");
 			}
+			else
+			{
+				// Transform only node (joint, group), an instance without geometry
+				object = MakeShr<Instance>();
+			}
 
 			object->objectName = node.name;
 			if (node.translation.size() > 0) {
@@ -402,6 +806,41 @@ namespace Skhole {
 			}
 		}
 
+		//-----------------------------------------------------
+		// Load Skin
+		//-----------------------------------------------------
+		for (const auto& gltfSkin : model.skins)
+		{
+			auto skin = MakeShr<Skin>();
+			skin->skinName = gltfSkin.name;
+			skin->jointObjects.assign(gltfSkin.joints.begin(), gltfSkin.joints.end());
+			skin->inverseBindMatrices.assign(gltfSkin.joints.size(), IdentityMat4());
+
+			if (gltfSkin.inverseBindMatrices >= 0) {
+				AccessorView view;
+				if (GetAccessorView(model, buffers, gltfSkin.inverseBindMatrices, view) &&
+					view.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && view.numComponent == 16 && view.count >= gltfSkin.joints.size()) {
+					for (size_t j = 0; j < gltfSkin.joints.size(); j++) {
+						// Column major
+						float value[16];
+						memcpy(value, view.data + j * view.byteStride, sizeof(value));
+
+						mat4& matrix = skin->inverseBindMatrices[j];
+						for (int r = 0; r < 4; r++) {
+							for (int c = 0; c < 4; c++) {
+								matrix[r][c] = value[c * 4 + r];
+							}
+						}
+					}
+				}
+				else {
+					SKHOLE_WARN("Not Compatible Inverse Bind Matrices : " + gltfSkin.name);
+				}
+			}
+
+			inSkins.push_back(skin);
+		}
+
 		//-----------------------------------------------------
 		// Load Material
 		//-----------------------------------------------------
@@ -522,16 +961,16 @@ namespace Skhole {
 					auto& animDataAccessor = model.accessors[sampler.output];
 
 					auto& animKeyBufferView = model.bufferViews[animKeyAccessor.bufferView];
-					auto& keyBuffer = model.buffers[animKeyBufferView.buffer];
-					auto keyPtr = keyBuffer.data.data() + animKeyBufferView.byteOffset + animKeyAccessor.byteOffset;
+					auto& keyBuffer = buffers[animKeyBufferView.buffer];
+					auto keyPtr = keyBuffer.data + animKeyBufferView.byteOffset + animKeyAccessor.byteOffset;
 					auto keyByteStride = animKeyAccessor.ByteStride(animKeyBufferView);
 					auto keyCount = animKeyAccessor.count;
 
 					FloatArray keyArray(keyPtr, keyCount, keyByteStride);
 
 					auto& animDataBufferView = model.bufferViews[animDataAccessor.bufferView];
-					auto& dataBuffer = model.buffers[animDataBufferView.buffer];
-					auto dataPtr = dataBuffer.data.data() + animDataBufferView.byteOffset + animDataAccessor.byteOffset;
+					auto& dataBuffer = buffers[animDataBufferView.buffer];
+					auto dataPtr = dataBuffer.data + animDataBufferView.byteOffset + animDataAccessor.byteOffset;
 					auto dataByteStride = animDataAccessor.ByteStride(animDataBufferView);
 					auto dataCount = animDataAccessor.count;
 
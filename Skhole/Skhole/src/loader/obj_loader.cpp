@@ -1,8 +1,12 @@
 
 #include <loader/obj_loader.h>
+#include <loader/vertex_weld.h>
+#include <common/parallel.h>
+#include <common/timer.h>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include <loader/obj_parser.h>
 
 namespace Skhole {
 	bool LoadObjFile(
@@ -10,7 +14,8 @@ namespace Skhole {
 		std::vector<ShrPtr<Object>>& inObjects,
 		std::vector<ShrPtr<Geometry>>& inGeometies,
 		std::vector<ShrPtr<BasicMaterial>>& inBasicMaterials,
-		std::vector<ShrPtr<Texture>>& inTextures
+		std::vector<ShrPtr<Texture>>& inTextures,
+		const ObjLoadOption& option
 	) {
 
 		tinyobj::attrib_t attrib;
@@ -20,7 +25,20 @@ namespace Skhole {
 		std::string warn;
 		std::string err;
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
+		bool parsed = false;
+		if (option.parallelParse) {
+			parsed = ParseObjFile(filename, attrib, shapes, materials, warn, err);
+			if (!parsed) {
+				SKHOLE_WARN("Parallel OBJ parse failed, fall back to tinyobj : " + err);
+				attrib = tinyobj::attrib_t();
+				shapes.clear();
+				materials.clear();
+				warn.clear();
+				err.clear();
+			}
+		}
+
+		if (!parsed && !tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
 			std::cerr << warn << std::endl;
 			std::cerr << err << std::endl;
 			return false;
@@ -36,11 +54,20 @@ namespace Skhole {
 
 		bool haveMaterial = materials.size() > 0;
 
-		for (size_t s = 0; s < shapes.size(); s++) {
+		Timer weldTimer;
+		weldTimer.Start();
+
+		std::vector<size_t> numCorners(shapes.size(), 0);
+
+		ParallelForDynamic(shapes.size(), [&](size_t s) {
 			size_t index_offset = 0;
 			auto& shape = shapes[s];
 			auto geometry = MakeShr<Geometry>();
 
+			std::vector<VertexData> corners;
+			corners.reserve(shape.mesh.indices.size());
+			geometry->m_materialIndices.reserve(shape.mesh.num_face_vertices.size());
+
 			// Mesh
 			for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
 				// Face
@@ -108,8 +135,7 @@ namespace Skhole {
 						);
 					}
 
-					geometry->m_vertices.push_back(vertex);
-					geometry->m_indices.push_back(geometry->m_indices.size());
+					corners.push_back(vertex);
 				}
 
 				index_offset += fv;
@@ -123,6 +149,20 @@ namespace Skhole {
 				}
 
 			}
+
+			numCorners[s] = corners.size();
+
+			if (option.weldVertices) {
+				WeldVertices(corners, geometry->m_vertices, geometry->m_indices);
+			}
+			else {
+				geometry->m_indices.resize(corners.size());
+				for (size_t i = 0; i < corners.size(); i++) {
+					geometry->m_indices[i] = static_cast<uint32_t>(i);
+				}
+				geometry->m_vertices = std::move(corners);
+			}
+
 			inGeometies[s] = geometry;
 
 			ShrPtr<Instance> instance = std::make_shared<Instance>();
@@ -133,6 +173,21 @@ namespace Skhole {
 			instance->localScale = vec3(1.0f);
 
 			inObjects[s] = instance;
+			});
+
+		if (option.weldVertices) {
+			size_t totalCorners = 0;
+			size_t totalVertices = 0;
+			for (size_t s = 0; s < shapes.size(); s++) {
+				totalCorners += numCorners[s];
+				totalVertices += inGeometies[s]->m_vertices.size();
+			}
+
+			float time = weldTimer.Stop();
+			float ratio = totalCorners > 0 ? float(totalVertices) / float(totalCorners) : 1.0f;
+			SKHOLE_LOG("Welded Vertices : " << totalCorners << " -> " << totalVertices << " ("
+				<< ratio * 100.0f << "%, " << (totalCorners - totalVertices) * sizeof(VertexData) / (1024.0 * 1024.0) << " MB saved, "
+				<< time * 1000.0f << " ms)");
 		}
 
 
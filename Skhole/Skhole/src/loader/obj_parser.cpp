@@ -0,0 +1,460 @@
+#include <loader/obj_parser.h>
+#include <common/log.h>
+#include <common/timer.h>
+#include <common/parallel.h>
+#include <common/mapped_file.h>
+
+#include <charconv>
+
+namespace Skhole {
+
+	//-----------------------------------------------------
+	// Chunk
+	//-----------------------------------------------------
+	// Result of one line aligned range of the file.
+	// Negative (relative) indices are resolved against the chunk and fixed after the merge.
+	struct ObjGroup {
+		std::string name;
+		bool inherit; // continues the group open at the end of the previous chunk
+		size_t firstFace;
+	};
+
+	struct ObjChunk {
+		std::vector<float> vertices;
+		std::vector<float> colors;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+		bool hasColor = false;
+
+		std::vector<tinyobj::index_t> indices; // 3 per face
+		std::vector<int> faceMaterial; // index of materialNames, -1 : inherit from previous chunk
+		std::vector<std::string> materialNames;
+		int lastMaterial = -1; // usemtl active at the end of the chunk
+		std::vector<ObjGroup> groups;
+		std::vector<std::string> mtllibs;
+
+		std::vector<size_t> relativeVertex;
+		std::vector<size_t> relativeTexcoord;
+		std::vector<size_t> relativeNormal;
+
+		size_t vertexBase = 0;
+		size_t texcoordBase = 0;
+		size_t normalBase = 0;
+
+		std::string error;
+	};
+
+	inline bool IsObjSpace(char c) {
+		return c == ' ' || c == '\t';
+	}
+
+	inline const char* SkipObjSpace(const char* p, const char* end) {
+		while (p < end && IsObjSpace(*p)) p++;
+		return p;
+	}
+
+	inline bool ParseObjFloat(const char*& p, const char* end, float& value) {
+		p = SkipObjSpace(p, end);
+		if (p < end && *p == '+') p++;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc()) return false;
+		p = result.ptr;
+		return true;
+	}
+
+	inline bool ParseObjInt(const char*& p, const char* end, int& value) {
+		if (p < end && *p == '+') p++;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc()) return false;
+		p = result.ptr;
+		return true;
+	}
+
+	inline std::string ParseObjName(const char* p, const char* end) {
+		p = SkipObjSpace(p, end);
+		while (end > p && (IsObjSpace(end[-1]) || end[-1] == '\r')) end--;
+		return std::string(p, end);
+	}
+
+	enum ObjRelativeFlag : uint8_t {
+		OBJ_RELATIVE_VERTEX = 1 << 0,
+		OBJ_RELATIVE_TEXCOORD = 1 << 1,
+		OBJ_RELATIVE_NORMAL = 1 << 2,
+	};
+
+	// v, v/t, v//n, v/t/n
+	// Positive indices become 0 based, negative ones are resolved against the chunk and flagged.
+	inline bool ParseObjFaceVertex(const char*& p, const char* end, const ObjChunk& chunk, tinyobj::index_t& index, uint8_t& relative) {
+		auto resolve = [&relative](int raw, size_t localCount, uint8_t flag, int& out) {
+			if (raw > 0) {
+				out = raw - 1;
+			}
+			else {
+				out = static_cast<int>(localCount) + raw;
+				relative |= flag;
+			}
+			};
+
+		index.vertex_index = -1;
+		index.texcoord_index = -1;
+		index.normal_index = -1;
+		relative = 0;
+
+		int raw;
+		if (!ParseObjInt(p, end, raw) || raw == 0) return false;
+		resolve(raw, chunk.vertices.size() / 3, OBJ_RELATIVE_VERTEX, index.vertex_index);
+
+		if (p < end && *p == '/') {
+			p++;
+			if (p < end && *p != '/') {
+				if (!ParseObjInt(p, end, raw) || raw == 0) return false;
+				resolve(raw, chunk.texcoords.size() / 2, OBJ_RELATIVE_TEXCOORD, index.texcoord_index);
+			}
+			if (p < end && *p == '/') {
+				p++;
+				if (!ParseObjInt(p, end, raw) || raw == 0) return false;
+				resolve(raw, chunk.normals.size() / 3, OBJ_RELATIVE_NORMAL, index.normal_index);
+			}
+		}
+
+		return true;
+	}
+
+	inline void ParseObjChunk(const char* begin, const char* end, ObjChunk& chunk)
+	{
+		chunk.groups.push_back({ "", true, 0 });
+		int currentMaterial = -1;
+
+		// Rough reservation from the chunk size
+		size_t reserveSize = (end - begin) / 40;
+		chunk.vertices.reserve(reserveSize);
+		chunk.indices.reserve(reserveSize * 2);
+
+		std::vector<tinyobj::index_t> polygon;
+		std::vector<uint8_t> polygonRelative;
+
+		auto pushCorner = [&chunk, &polygon, &polygonRelative](size_t k) {
+			size_t slot = chunk.indices.size();
+			if (polygonRelative[k] & OBJ_RELATIVE_VERTEX) chunk.relativeVertex.push_back(slot);
+			if (polygonRelative[k] & OBJ_RELATIVE_TEXCOORD) chunk.relativeTexcoord.push_back(slot);
+			if (polygonRelative[k] & OBJ_RELATIVE_NORMAL) chunk.relativeNormal.push_back(slot);
+			chunk.indices.push_back(polygon[k]);
+			};
+
+		const char* line = begin;
+		while (line < end) {
+			const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+			if (lineEnd == nullptr) lineEnd = end;
+
+			const char* p = SkipObjSpace(line, lineEnd);
+			const char* next = lineEnd + 1;
+
+			if (p >= lineEnd || *p == '#' || *p == '\r') {
+				line = next;
+				continue;
+			}
+
+			bool ok = true;
+			if (p[0] == 'v' && p + 1 < lineEnd && IsObjSpace(p[1])) {
+				p += 2;
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				ok = ParseObjFloat(p, lineEnd, x) && ParseObjFloat(p, lineEnd, y) && ParseObjFloat(p, lineEnd, z);
+				chunk.vertices.push_back(x);
+				chunk.vertices.push_back(y);
+				chunk.vertices.push_back(z);
+
+				// Optional vertex color : v x y z r g b
+				float r = 1.0f, g = 1.0f, b = 1.0f;
+				const char* colorPtr = p;
+				if (ParseObjFloat(colorPtr, lineEnd, r) && ParseObjFloat(colorPtr, lineEnd, g) && ParseObjFloat(colorPtr, lineEnd, b)) {
+					if (!chunk.hasColor) {
+						chunk.colors.assign(chunk.vertices.size() - 3, 1.0f);
+						chunk.hasColor = true;
+					}
+				}
+				else {
+					r = g = b = 1.0f;
+				}
+				if (chunk.hasColor) {
+					chunk.colors.push_back(r);
+					chunk.colors.push_back(g);
+					chunk.colors.push_back(b);
+				}
+			}
+			else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 'n' && IsObjSpace(p[2])) {
+				p += 3;
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				ok = ParseObjFloat(p, lineEnd, x) && ParseObjFloat(p, lineEnd, y) && ParseObjFloat(p, lineEnd, z);
+				chunk.normals.push_back(x);
+				chunk.normals.push_back(y);
+				chunk.normals.push_back(z);
+			}
+			else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 't' && IsObjSpace(p[2])) {
+				p += 3;
+				float u = 0.0f, v = 0.0f;
+				ok = ParseObjFloat(p, lineEnd, u);
+				if (!ParseObjFloat(p, lineEnd, v)) v = 0.0f;
+				chunk.texcoords.push_back(u);
+				chunk.texcoords.push_back(v);
+			}
+			else if (p[0] == 'f' && p + 1 < lineEnd && IsObjSpace(p[1])) {
+				p += 2;
+				polygon.clear();
+				polygonRelative.clear();
+				while (true) {
+					p = SkipObjSpace(p, lineEnd);
+					if (p >= lineEnd || *p == '\r' || *p == '#') break;
+
+					tinyobj::index_t index;
+					uint8_t relative;
+					if (!ParseObjFaceVertex(p, lineEnd, chunk, index, relative)) {
+						ok = false;
+						break;
+					}
+					polygon.push_back(index);
+					polygonRelative.push_back(relative);
+				}
+
+				if (ok && polygon.size() >= 3) {
+					// Fan triangulation
+					for (size_t k = 1; k + 1 < polygon.size(); k++) {
+						pushCorner(0);
+						pushCorner(k);
+						pushCorner(k + 1);
+						chunk.faceMaterial.push_back(currentMaterial);
+					}
+				}
+			}
+			else if ((p[0] == 'o' || p[0] == 'g') && p + 1 < lineEnd && IsObjSpace(p[1])) {
+				chunk.groups.push_back({ ParseObjName(p + 2, lineEnd), false, chunk.indices.size() / 3 });
+			}
+			else if (lineEnd - p > 7 && strncmp(p, "usemtl", 6) == 0 && IsObjSpace(p[6])) {
+				std::string name = ParseObjName(p + 7, lineEnd);
+				auto it = std::find(chunk.materialNames.begin(), chunk.materialNames.end(), name);
+				currentMaterial = static_cast<int>(it - chunk.materialNames.begin());
+				if (it == chunk.materialNames.end()) chunk.materialNames.push_back(name);
+			}
+			else if (lineEnd - p > 7 && strncmp(p, "mtllib", 6) == 0 && IsObjSpace(p[6])) {
+				chunk.mtllibs.push_back(ParseObjName(p + 7, lineEnd));
+			}
+
+			if (!ok) {
+				chunk.error = "Failed to parse line : " + std::string(line, std::min<size_t>(lineEnd - line, 64));
+				return;
+			}
+
+			line = next;
+		}
+
+		chunk.lastMaterial = currentMaterial;
+	}
+
+	//-----------------------------------------------------
+	// Parse
+	//-----------------------------------------------------
+	bool ParseObjFile(
+		const std::string& filename,
+		tinyobj::attrib_t& attrib,
+		std::vector<tinyobj::shape_t>& shapes,
+		std::vector<tinyobj::material_t>& materials,
+		std::string& warn,
+		std::string& err
+	)
+	{
+		Timer timer;
+		timer.Start();
+
+		MappedFile file;
+		if (!file.Open(filename)) {
+			err = "Failed to open file : " + filename;
+			return false;
+		}
+
+		const char* data = reinterpret_cast<const char*>(file.GetData());
+		const size_t size = file.GetSize();
+
+		// Line aligned chunks, a few per worker for balance
+		constexpr size_t MIN_CHUNK_BYTES = size_t(1) << 20;
+		size_t numChunk = std::max<size_t>(1, std::min<size_t>(GetWorkerCount() * 4, size / MIN_CHUNK_BYTES));
+
+		std::vector<size_t> chunkBegin(numChunk + 1);
+		chunkBegin[0] = 0;
+		chunkBegin[numChunk] = size;
+		for (size_t i = 1; i < numChunk; i++) {
+			size_t pos = std::max(size * i / numChunk, chunkBegin[i - 1]);
+			const char* newline = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+			chunkBegin[i] = newline ? (newline - data) + 1 : size;
+		}
+
+		std::vector<ObjChunk> chunks(numChunk);
+		ParallelForDynamic(numChunk, [&](size_t i) {
+			const char* begin = data + chunkBegin[i];
+			const char* end = data + chunkBegin[i + 1];
+			ParseObjChunk(begin, end, chunks[i]);
+			});
+
+		for (auto& chunk : chunks) {
+			if (!chunk.error.empty()) {
+				err = chunk.error;
+				return false;
+			}
+		}
+
+		//-----------------------------------------------------
+		// Materials
+		//-----------------------------------------------------
+		std::map<std::string, int> materialMap;
+		materials.clear();
+		{
+			std::string dir = std::filesystem::path(filename).parent_path().string();
+			if (!dir.empty()) dir += "/";
+
+			for (auto& chunk : chunks) {
+				for (auto& mtllib : chunk.mtllibs) {
+					std::ifstream mtlFile(dir + mtllib);
+					if (!mtlFile.is_open()) {
+						warn += "Material file not found : " + mtllib + "\n";
+						continue;
+					}
+					tinyobj::LoadMtl(&materialMap, &materials, &mtlFile, &warn, &err);
+				}
+			}
+		}
+
+		//-----------------------------------------------------
+		// Merge Attributes
+		//-----------------------------------------------------
+		bool hasColor = false;
+		size_t numVertex = 0, numTexcoord = 0, numNormal = 0;
+		for (auto& chunk : chunks) {
+			chunk.vertexBase = numVertex;
+			chunk.texcoordBase = numTexcoord;
+			chunk.normalBase = numNormal;
+			numVertex += chunk.vertices.size() / 3;
+			numTexcoord += chunk.texcoords.size() / 2;
+			numNormal += chunk.normals.size() / 3;
+			hasColor |= chunk.hasColor;
+		}
+
+		attrib.vertices.resize(numVertex * 3);
+		attrib.texcoords.resize(numTexcoord * 2);
+		attrib.normals.resize(numNormal * 3);
+		attrib.colors.clear();
+		if (hasColor) attrib.colors.resize(numVertex * 3);
+
+		// Material ids, and the usemtl each chunk starts with
+		std::vector<std::vector<int>> materialIds(numChunk);
+		std::vector<int> inheritMaterial(numChunk, -1);
+		int activeMaterial = -1;
+		for (size_t i = 0; i < numChunk; i++) {
+			auto& chunk = chunks[i];
+			materialIds[i].resize(chunk.materialNames.size());
+			for (size_t m = 0; m < chunk.materialNames.size(); m++) {
+				auto it = materialMap.find(chunk.materialNames[m]);
+				materialIds[i][m] = (it != materialMap.end()) ? it->second : -1;
+			}
+
+			inheritMaterial[i] = activeMaterial;
+			if (chunk.lastMaterial >= 0) activeMaterial = materialIds[i][chunk.lastMaterial];
+		}
+
+		ParallelForDynamic(numChunk, [&](size_t i) {
+			auto& chunk = chunks[i];
+			std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib.vertices.begin() + chunk.vertexBase * 3);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + chunk.texcoordBase * 2);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + chunk.normalBase * 3);
+			if (hasColor) {
+				if (chunk.hasColor) {
+					std::copy(chunk.colors.begin(), chunk.colors.end(), attrib.colors.begin() + chunk.vertexBase * 3);
+				}
+				else {
+					std::fill(attrib.colors.begin() + chunk.vertexBase * 3, attrib.colors.begin() + (chunk.vertexBase * 3 + chunk.vertices.size()), 1.0f);
+				}
+			}
+
+			// Relative indices to global
+			for (size_t slot : chunk.relativeVertex) chunk.indices[slot].vertex_index += static_cast<int>(chunk.vertexBase);
+			for (size_t slot : chunk.relativeTexcoord) chunk.indices[slot].texcoord_index += static_cast<int>(chunk.texcoordBase);
+			for (size_t slot : chunk.relativeNormal) chunk.indices[slot].normal_index += static_cast<int>(chunk.normalBase);
+
+			// Material name to id
+			for (auto& material : chunk.faceMaterial) {
+				material = (material >= 0) ? materialIds[i][material] : inheritMaterial[i];
+			}
+			});
+
+		//-----------------------------------------------------
+		// Shapes
+		//-----------------------------------------------------
+		// Face runs of each shape, in file order
+		struct FaceRun {
+			size_t chunk;
+			size_t begin;
+			size_t end;
+			size_t dst;
+		};
+		struct ShapeRuns {
+			std::string name;
+			std::vector<FaceRun> runs;
+			size_t numFace = 0;
+		};
+
+		std::vector<ShapeRuns> shapeRuns;
+		shapeRuns.push_back({ "", {}, 0 });
+		for (size_t c = 0; c < numChunk; c++) {
+			auto& chunk = chunks[c];
+			size_t numFace = chunk.indices.size() / 3;
+			for (size_t g = 0; g < chunk.groups.size(); g++) {
+				auto& group = chunk.groups[g];
+				if (!group.inherit) {
+					shapeRuns.push_back({ group.name, {}, 0 });
+				}
+				size_t begin = group.firstFace;
+				size_t end = (g + 1 < chunk.groups.size()) ? chunk.groups[g + 1].firstFace : numFace;
+				if (end > begin) {
+					auto& shape = shapeRuns.back();
+					shape.runs.push_back({ c, begin, end, shape.numFace });
+					shape.numFace += end - begin;
+				}
+			}
+		}
+
+		shapes.clear();
+		std::vector<size_t> shapeIndex(shapeRuns.size(), size_t(-1));
+		for (size_t s = 0; s < shapeRuns.size(); s++) {
+			if (shapeRuns[s].numFace == 0) continue;
+			shapeIndex[s] = shapes.size();
+
+			tinyobj::shape_t shape;
+			shape.name = shapeRuns[s].name;
+			shape.mesh.indices.resize(shapeRuns[s].numFace * 3);
+			shape.mesh.num_face_vertices.assign(shapeRuns[s].numFace, 3);
+			shape.mesh.material_ids.resize(shapeRuns[s].numFace);
+			shape.mesh.smoothing_group_ids.assign(shapeRuns[s].numFace, 0);
+			shapes.push_back(std::move(shape));
+		}
+
+		// Copy runs, every run has its own destination range
+		std::vector<std::pair<size_t, const FaceRun*>> copyJobs;
+		for (size_t s = 0; s < shapeRuns.size(); s++) {
+			if (shapeIndex[s] == size_t(-1)) continue;
+			for (auto& run : shapeRuns[s].runs) copyJobs.push_back({ shapeIndex[s], &run });
+		}
+
+		ParallelForDynamic(copyJobs.size(), [&](size_t i) {
+			auto& mesh = shapes[copyJobs[i].first].mesh;
+			const FaceRun& run = *copyJobs[i].second;
+			const auto& chunk = chunks[run.chunk];
+
+			std::copy(chunk.indices.begin() + run.begin * 3, chunk.indices.begin() + run.end * 3, mesh.indices.begin() + run.dst * 3);
+			std::copy(chunk.faceMaterial.begin() + run.begin, chunk.faceMaterial.begin() + run.end, mesh.material_ids.begin() + run.dst);
+			});
+
+		float time = timer.Stop();
+		double sizeMB = size / (1024.0 * 1024.0);
+		SKHOLE_LOG("Parsed OBJ : " << sizeMB << " MB, " << time * 1000.0f << " ms, "
+			<< (time > 0.0f ? sizeMB / time : 0.0) << " MB/s, " << numChunk << " chunks");
+
+		return true;
+	}
+}
@@ -2,6 +2,8 @@
 //#include <renderer/sample_renderer.h>
 #include <cxxopts.hpp>
 #include <common/filepath.h>
+#include <common/timer.h>
+#include <loader/loader.h>
 
 inline void ExecuteEditor() {
 	Skhole::Application app;
@@ -27,6 +29,72 @@ inline void ExecuteRender(const Skhole::FilePath& filepath, const Skhole::FilePa
 	app.RunRenderMode(desc);
 }
 
+// Loads the file repeatedly without the import cache and reports the load time
+inline void ExecuteLoaderBenchmark(const Skhole::FilePath& filepath, int iterations) {
+	std::string path = filepath.GetFullPath();
+	std::string extension;
+	if (!Skhole::GetFileExtension(path, extension)) {
+		std::cout << "Invalid File Path" << std::endl;
+		return;
+	}
+
+	std::cout << "filepath: " << path << std::endl;
+
+	std::vector<float> times;
+	size_t numVertex = 0;
+	size_t numIndex = 0;
+
+	for (int i = 0; i < iterations; i++) {
+		std::vector<ShrPtr<Skhole::Object>> objects;
+		std::vector<ShrPtr<Skhole::Geometry>> geometries;
+		std::vector<ShrPtr<Skhole::BasicMaterial>> materials;
+		std::vector<ShrPtr<Skhole::Texture>> textures;
+		std::vector<ShrPtr<Skhole::Skin>> skins;
+
+		Skhole::Timer timer;
+		timer.Start();
+
+		bool result = false;
+		if (extension == "obj") {
+			result = Skhole::LoadObjFile(path, objects, geometries, materials, textures);
+		}
+		else if (extension == "glb" || extension == "gltf") {
+			result = Skhole::LoadGLTFFile(path, objects, geometries, materials, textures, skins);
+		}
+		else {
+			std::cout << "Not Compatible File : " << extension << std::endl;
+			return;
+		}
+
+		times.push_back(timer.Stop());
+
+		if (!result) {
+			std::cout << "Failed to load file" << std::endl;
+			return;
+		}
+
+		numVertex = 0;
+		numIndex = 0;
+		for (auto& geometry : geometries) {
+			numVertex += geometry->m_vertices.size();
+			numIndex += geometry->m_indices.size();
+		}
+	}
+
+	if (times.size() == 0) return;
+
+	float sum = 0.0f;
+	for (float time : times) sum += time;
+	std::sort(times.begin(), times.end());
+
+	std::cout << "iterations: " << times.size() << std::endl;
+	std::cout << "vertices: " << numVertex << ", indices: " << numIndex << std::endl;
+	std::cout << "min: " << times.front() * 1000.0f << " ms" << std::endl;
+	std::cout << "median: " << times[times.size() / 2] * 1000.0f << " ms" << std::endl;
+	std::cout << "avg: " << sum / times.size() * 1000.0f << " ms" << std::endl;
+	std::cout << "max: " << times.back() * 1000.0f << " ms" << std::endl;
+}
+
 int main(int argc, char* argv[]) {
 	try {
 		cxxopts::Options options("Skhole", "Commands");
@@ -35,7 +103,8 @@ int main(int argc, char* argv[]) {
 			("h,help", "wv\")
 			("f,file", "̓t@C", cxxopts::value<std::string>())
 			("o,out", "o͐", cxxopts::value<std::string>())
-			("m,mode", "[h editor, render", cxxopts::value<std::string>());
+			("m,mode", "[h editor, render, bench", cxxopts::value<std::string>())
+			("n,iteration", "Benchmark iterations", cxxopts::value<int>()->default_value("5"));
 
 		auto result = options.parse(argc, argv);
 
@@ -72,6 +141,17 @@ int main(int argc, char* argv[]) {
 
 					ExecuteRender(filepath, outpath);
 				}
+				else if (mode == "bench") {
+					std::cout << "------------Execute Loader Benchmark----------------" << std::endl;
+
+					if (!result.count("file")) {
+						std::cout << "Benchmark needs a file (-f)" << std::endl;
+						return -1;
+					}
+
+					Skhole::FilePath filepath(result["file"].as<std::string>());
+					ExecuteLoaderBenchmark(filepath, result["iteration"].as<int>());
+				}
 				else {
 					std::cout << "Invalid Mode" << std::endl;
 					std::cout << "------------Execute Editor Mode----------------" << std::endl;
@@ -20,11 +20,12 @@ namespace Skhole {
 		{
 			{0, vk::DescriptorType::eStorageImage, 1,vk::ShaderStageFlagBits::eCompute},
 			{1, vk::DescriptorType::eStorageImage,1, vk::ShaderStageFlagBits::eCompute},
-			{2, vk::DescriptorType::eUniformBuffer,1, vk::ShaderStageFlagBits::eCompute}
+			{2, vk::DescriptorType::eUniformBufferDynamic,1, vk::ShaderStageFlagBits::eCompute}
 		};
 
 		layerDesc.device = device;
 		layerDesc.physicalDevice = physicalDevice;
+		layerDesc.numFrame = desc.numFrame;
 
 		layer1.Init(layerDesc);
 
@@ -33,7 +34,7 @@ namespace Skhole {
 			device,
 			sizeof(UniformObject),
 			vk::BufferUsageFlagBits::eUniformBuffer,
-			vk::MemoryPropertyFlagBits::eHostCached | vk::MemoryPropertyFlagBits::eHostVisible
+			desc.numFrame
 		);
 
 		SKHOLE_LOG("... End Initialization PostProcessor");
@@ -56,13 +57,14 @@ namespace Skhole {
 		uniformObject.color = CastParamCol(parameter[0])->value;
 		uniformObject.intensity = CastParamFloat(parameter[1])->value;
 
-		CopyBuffer(device, uniformBuffer, &uniformObject, uniformBuffer.GetBufferSize());
+		memcpy(uniformBuffer.GetSlice(desc.frameIndex), &uniformObject, sizeof(UniformObject));
 
+		layer1.SetFrame(desc.frameIndex);
 		layer1.StartBinding();
 
 		layer1.SetImage(desc.inputImage, 0, device);
 		layer1.SetImage(desc.outputImage, 1, device);
-		layer1.SetUniformBuffer(*uniformBuffer.buffer, uniformBuffer.GetBufferSize(), 2, device);
+		layer1.SetDynamicUniformBuffer(uniformBuffer.GetBuffer(), uniformBuffer.GetRange(), 2, uniformBuffer.GetOffset(desc.frameIndex), device);
 
 		layer1.EndBinding(device);
 	}
@@ -82,5 +84,6 @@ namespace Skhole {
 
 	void PPExample::Destroy(vk::Device device) {
 		layer1.Destroy(device);
+		uniformBuffer.Release(device);
 	}
 }
\ No newline at end of file
@@ -9,7 +9,7 @@ namespace Skhole {
 
 		csModule = vkutils::createShaderModule(device, csShaderPath);
 
-		bindingManager.SetBindingLayout(device, binding, vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+		bindingManager.SetBindingLayout(device, binding, vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, desc.numFrame);
 
 		vk::PipelineShaderStageCreateInfo shaderStageInfo{};
 		shaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
@@ -29,8 +29,13 @@ namespace Skhole {
 		computePipeline = std::move(result.value);
 	}
 
+	void PPLayer::SetFrame(uint32_t frameIndex) {
+		bindingManager.SetFrame(frameIndex);
+	}
+
 	void PPLayer::StartBinding() {
 		bindingManager.StartWriting();
+		dynamicOffsets.clear();
 	}
 
 	void PPLayer::EndBinding(vk::Device device) {
@@ -45,6 +50,13 @@ namespace Skhole {
 		bindingManager.WriteBuffer(buffer, 0, size, vk::DescriptorType::eUniformBuffer, bindingIndex, 1, device);
 	}
 
+	// The binding has to be eUniformBufferDynamic, offset is applied when the layer is executed.
+	// Dynamic buffers have to be set in binding order.
+	void PPLayer::SetDynamicUniformBuffer(const vk::Buffer& buffer, size_t size, uint32_t bindingIndex, uint32_t offset, vk::Device device) {
+		bindingManager.WriteBuffer(buffer, 0, size, vk::DescriptorType::eUniformBufferDynamic, bindingIndex, 1, device);
+		dynamicOffsets.push_back(offset);
+	}
+
 	void PPLayer::SetImage(const vk::ImageView& image, uint32_t bindingIndex, vk::Device device)
 	{
 		bindingManager.WriteImage(
@@ -55,7 +67,7 @@ namespace Skhole {
 
 	void PPLayer::Execute(vk::CommandBuffer command, uint32_t dispatchW, uint32_t dispatchH) {
 		command.bindPipeline(vk::PipelineBindPoint::eCompute, *computePipeline);
-		command.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 0, bindingManager.descriptorSet, nullptr);
+		command.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 0, bindingManager.descriptorSet, dynamicOffsets);
 		command.dispatch(dispatchW, dispatchH, 1);
 	}
 
@@ -150,7 +150,7 @@ namespace Skhole {
 		// Copy handles
 		uint32_t handleIndex = 0;
 		uint8_t* sbtHead =
-			static_cast<uint8_t*>(device.mapMemory(*sbt.memory, 0, sbtSize));
+			static_cast<uint8_t*>(sbt.Map(device, 0, sbtSize));
 
 		uint8_t* dstPtr = sbtHead;
 		auto copyHandle = [&](uint32_t index) {
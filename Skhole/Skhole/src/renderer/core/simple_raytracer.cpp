@@ -23,7 +23,7 @@ namespace Skhole {
 	{
 		SKHOLE_LOG_SECTION("Initialze Renderer");
 
-		m_uniformBuffer.Init(m_context.physicalDevice, *m_context.device);
+		m_uniformBuffer.Init(m_context.physicalDevice, *m_context.device, MAX_FRAMES_IN_FLIGHT);
 
 		auto& uniformBufferObject = m_uniformBuffer.data;
 		uniformBufferObject.frame = 0;
@@ -42,6 +42,10 @@ namespace Skhole {
 
 	void SimpleRaytracer::DestroyScene()
 	{
+		WaitFrames();
+		m_uploadManager.Wait(*m_context.device, m_uploadManager.Flush(*m_context.device));
+
+		m_skinningPass.Release(*m_context.device);
 		m_sceneBufferManager.Release(*m_context.device);
 		m_asManager.ReleaseTLAS(*m_context.device);
 		m_asManager.ReleaseBLAS(*m_context.device);
@@ -58,6 +62,7 @@ namespace Skhole {
 
 		m_asManager.ReleaseBLAS(*m_context.device);
 		m_asManager.ReleaseTLAS(*m_context.device);
+		m_skinningPass.Release(*m_context.device);
 		m_sceneBufferManager.Release(*m_context.device);
 	}
 
@@ -66,8 +71,11 @@ namespace Skhole {
 		SKHOLE_LOG_SECTION("Set Scene");
 		m_scene = scene;
 		m_sceneBufferManager.SetScene(m_scene);
-		m_sceneBufferManager.InitGeometryBuffer(m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
-		m_sceneBufferManager.InitInstanceBuffer(m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
+		m_sceneBufferManager.SetVertexAttributes(VERTEX_ATTRIBUTE_BIT_NORMAL);
+		m_sceneBufferManager.InitGeometryBuffer(m_context.physicalDevice, *m_context.device, m_uploadManager);
+		m_skinningPass.Init(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, m_uploadManager);
+		m_sceneBufferManager.InitInstanceBuffer(m_context.physicalDevice, *m_context.device, MAX_FRAMES_IN_FLIGHT);
+		m_uploadManager.Flush(*m_context.device);
 
 		m_asManager.BuildBLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
 
@@ -87,9 +95,13 @@ namespace Skhole {
 				index++;
 			}
 
-			m_materialBuffer.UpdateBuffer(*m_context.device, *m_commandPool, m_context.queue);
+			m_materialBuffer.UpdateBuffer(*m_context.device, m_uploadManager);
 		}
 
+		// Frame updates allocate staging chunks again when needed
+		m_uploadManager.ReleaseStaging(*m_context.device);
+
+		GetMemoryAllocator().LogStatistics();
 		SKHOLE_LOG_SECTION("End Set Scene");
 	}
 
@@ -114,6 +126,7 @@ namespace Skhole {
 			case UpdateCommandType::OBJECT:
 				objCommand = std::static_pointer_cast<UpdateObjectCommand>(command);
 				m_scene->m_objects[objCommand->objectIndex]->ResetWorldTransformMatrix();
+				m_sceneBufferManager.MarkObjectDirty(objCommand->objectIndex);
 				break;
 			default:
 				SKHOLE_UNIMPL("Command");
@@ -153,17 +166,28 @@ namespace Skhole {
 		uniformBufferObject.cameraParam.x = camera->GetYFov();
 		uniformBufferObject.cameraParam.y = static_cast<float>(width) / static_cast<float>(height);
 
-		m_uniformBuffer.Update(*m_context.device);
+		m_uniformBuffer.Update(*m_context.device, m_frameIndex);
 
 		m_scene->SetTransformMatrix(time);
-		m_sceneBufferManager.FrameUpdateInstance(time, *m_context.device, *m_commandPool, m_context.queue);
-		m_asManager.BuildTLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
+		m_sceneBufferManager.FrameUpdateInstance(time, *m_context.device, m_frameIndex);
+
+		// Vertex buffers and AS are shared by the frames in flight, they are waited for only when something moved
+		if (m_skinningPass.IsActive() || m_sceneBufferManager.HasGeometryUpdate() || m_asManager.IsTLASOutdated(m_sceneBufferManager)) {
+			WaitFrames();
+
+			auto updatedGeometries = m_sceneBufferManager.FrameUpdateGeometry(*m_context.device, m_uploadManager);
+			m_uploadManager.Flush(*m_context.device);
+			m_skinningPass.Execute(time, m_sceneBufferManager, *m_context.device, *m_commandPool, m_context.queue, updatedGeometries);
+			m_asManager.UpdateBLAS(m_sceneBufferManager, updatedGeometries, *m_context.device, *m_commandPool, m_context.queue);
+			m_asManager.BuildTLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
+		}
+
+		// Material edits of UpdateScene
+		m_uploadManager.Flush(*m_context.device);
 	}
 
 	void SimpleRaytracer::FrameEnd()
 	{
-		m_asManager.ReleaseTLAS(*m_context.device);
-
 		auto& raytracerParam = m_scene->m_rendererParameter;
 		raytracerParam->numSPP++;
 		if (raytracerParam->numSPP >= raytracerParam->maxSPP) {
@@ -173,41 +197,26 @@ namespace Skhole {
 
 	void SimpleRaytracer::RealTimeRender(const RealTimeRenderingInfo& renderInfo)
 	{
+		// Only the frame submitted MAX_FRAMES_IN_FLIGHT frames ago is waited for
+		WaitFrame();
+
 		FrameStart(renderInfo.time);
 
-		vk::UniqueSemaphore imageAvailableSemaphore =
-			m_context.device->createSemaphoreUnique({});
+		uint32_t width = m_renderImages.GetWidth();
+		uint32_t height = m_renderImages.GetHeight();
 
+		UpdateDescriptorSet(m_frameIndex);
 
-		uint32_t imageIndex = m_screenContext.GetFrameIndex(*m_context.device, *imageAvailableSemaphore);
+		vk::CommandBuffer commandBuffer = *m_frames[m_frameIndex].commandBuffer;
+		commandBuffer.begin(vk::CommandBufferBeginInfo{});
+		RecordCommandBuffer(commandBuffer, width, height);
 
-		uint32_t width = m_renderImages.GetWidth();
-		uint32_t height = m_renderImages.GetHeight();
+		uint32_t imageIndex = AcquireFrame();
+		CopyRenderToScreen(commandBuffer, m_renderImages.GetPostProcessedImage().GetImage(), m_screenContext.GetFrameImage(imageIndex), width, height);
+		RenderImGuiCommand(commandBuffer, m_screenContext.GetFrameBuffer(imageIndex), width, height);
+		commandBuffer.end();
 
-		UpdateDescriptorSet();
-
-		m_commandBuffer->begin(vk::CommandBufferBeginInfo{});
-		RecordCommandBuffer(width, height);
-		CopyRenderToScreen(*m_commandBuffer, m_renderImages.GetPostProcessedImage().GetImage(), m_screenContext.GetFrameImage(imageIndex), width, height);
-		RenderImGuiCommand(*m_commandBuffer, m_screenContext.GetFrameBuffer(imageIndex), width, height);
-		m_commandBuffer->end();
-
-		vk::PipelineStageFlags waitStage{ vk::PipelineStageFlagBits::eTopOfPipe };
-		vk::SubmitInfo submitInfo{};
-		submitInfo.setWaitDstStageMask(waitStage);
-		submitInfo.setCommandBuffers(*m_commandBuffer);
-		submitInfo.setWaitSemaphores(*imageAvailableSemaphore);
-		m_context.queue.submit(submitInfo);
-
-		m_context.queue.waitIdle();
-
-		vk::PresentInfoKHR presentInfo{};
-		presentInfo.setSwapchains(*m_screenContext.swapchain);
-		presentInfo.setImageIndices(imageIndex);
-		if (m_context.queue.presentKHR(presentInfo) != vk::Result::eSuccess) {
-			std::cerr << "Failed to present.\n";
-			std::abort();
-		}
+		SubmitFrame(imageIndex);
 
 		FrameEnd();
 	}
@@ -20,7 +20,7 @@ namespace Skhole {
 	{
 		SKHOLE_LOG_SECTION("Initialze Renderer");
 
-		m_uniformBuffer.Init(m_context.physicalDevice, *m_context.device);
+		m_uniformBuffer.Init(m_context.physicalDevice, *m_context.device, MAX_FRAMES_IN_FLIGHT);
 
 		auto& uniformBufferObject = m_uniformBuffer.data;
 		uniformBufferObject.frame = 0;
@@ -39,6 +39,10 @@ namespace Skhole {
 
 	void VNDF_Renderer::DestroyScene()
 	{
+		WaitFrames();
+		m_uploadManager.Wait(*m_context.device, m_uploadManager.Flush(*m_context.device));
+
+		m_skinningPass.Release(*m_context.device);
 		m_sceneBufferManager.Release(*m_context.device);
 		m_asManager.ReleaseTLAS(*m_context.device);
 		m_asManager.ReleaseBLAS(*m_context.device);
@@ -55,6 +59,7 @@ namespace Skhole {
 
 		m_asManager.ReleaseBLAS(*m_context.device);
 		m_asManager.ReleaseTLAS(*m_context.device);
+		m_skinningPass.Release(*m_context.device);
 		m_sceneBufferManager.Release(*m_context.device);
 	}
 
@@ -63,8 +68,12 @@ namespace Skhole {
 		SKHOLE_LOG_SECTION("Set Scene");
 		m_scene = scene;
 		m_sceneBufferManager.SetScene(m_scene);
-		m_sceneBufferManager.InitGeometryBuffer(m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
-		m_sceneBufferManager.InitInstanceBuffer(m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
+		m_sceneBufferManager.SetVertexFormat(m_scene->m_vertexFormat);
+		m_sceneBufferManager.SetVertexAttributes(VERTEX_ATTRIBUTE_BIT_NORMAL | VERTEX_ATTRIBUTE_BIT_TEXCOORD0);
+		m_sceneBufferManager.InitGeometryBuffer(m_context.physicalDevice, *m_context.device, m_uploadManager);
+		m_skinningPass.Init(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, m_uploadManager);
+		m_sceneBufferManager.InitInstanceBuffer(m_context.physicalDevice, *m_context.device, MAX_FRAMES_IN_FLIGHT);
+		m_uploadManager.Flush(*m_context.device);
 
 		m_asManager.BuildBLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
 
@@ -84,9 +93,13 @@ namespace Skhole {
 				index++;
 			}
 
-			m_materialBuffer.UpdateBuffer(*m_context.device, *m_commandPool, m_context.queue);
+			m_materialBuffer.UpdateBuffer(*m_context.device, m_uploadManager);
 		}
 
+		// Frame updates allocate staging chunks again when needed
+		m_uploadManager.ReleaseStaging(*m_context.device);
+
+		GetMemoryAllocator().LogStatistics();
 		SKHOLE_LOG_SECTION("End Set Scene");
 	}
 
@@ -111,6 +124,7 @@ namespace Skhole {
 			case UpdateCommandType::OBJECT:
 				objCommand = std::static_pointer_cast<UpdateObjectCommand>(command);
 				m_scene->m_objects[objCommand->objectIndex]->ResetWorldTransformMatrix();
+				m_sceneBufferManager.MarkObjectDirty(objCommand->objectIndex);
 				break;
 			default:
 				SKHOLE_UNIMPL("Command");
@@ -128,8 +142,21 @@ namespace Skhole {
 	void VNDF_Renderer::FrameStart(float time)
 	{
 		m_scene->SetTransformMatrix(time);
-		m_sceneBufferManager.FrameUpdateInstance(time, *m_context.device, *m_commandPool, m_context.queue);
-		m_asManager.BuildTLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
+		m_sceneBufferManager.FrameUpdateInstance(time, *m_context.device, m_frameIndex);
+
+		// Vertex buffers and AS are shared by the frames in flight, they are waited for only when something moved
+		if (m_skinningPass.IsActive() || m_sceneBufferManager.HasGeometryUpdate() || m_asManager.IsTLASOutdated(m_sceneBufferManager)) {
+			WaitFrames();
+
+			auto updatedGeometries = m_sceneBufferManager.FrameUpdateGeometry(*m_context.device, m_uploadManager);
+			m_uploadManager.Flush(*m_context.device);
+			m_skinningPass.Execute(time, m_sceneBufferManager, *m_context.device, *m_commandPool, m_context.queue, updatedGeometries);
+			m_asManager.UpdateBLAS(m_sceneBufferManager, updatedGeometries, *m_context.device, *m_commandPool, m_context.queue);
+			m_asManager.BuildTLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
+		}
+
+		// Material edits of UpdateScene
+		m_uploadManager.Flush(*m_context.device);
 
 		auto& raytracerParam = m_scene->m_rendererParameter;
 
@@ -158,13 +185,11 @@ namespace Skhole {
 		uniformBufferObject.lightColor = GetParamColValue(raytracerParam->rendererParameters[2]);
 		uniformBufferObject.lightIntensity = GetParamFloatValue(raytracerParam->rendererParameters[3]);
 
-		m_uniformBuffer.Update(*m_context.device);
+		m_uniformBuffer.Update(*m_context.device, m_frameIndex);
 	}
 
 	void VNDF_Renderer::FrameEnd()
 	{
-		m_asManager.ReleaseTLAS(*m_context.device);
-
 		auto& raytracerParam = m_scene->m_rendererParameter;
 		raytracerParam->numSPP += m_scene->m_rendererParameter->sppPerFrame;
 		if (raytracerParam->numSPP >= raytracerParam->maxSPP) {
@@ -174,48 +199,37 @@ namespace Skhole {
 
 	void VNDF_Renderer::RealTimeRender(const RealTimeRenderingInfo& renderInfo)
 	{
-		FrameStart(renderInfo.time);
-
-		vk::UniqueSemaphore imageAvailableSemaphore =
-			m_context.device->createSemaphoreUnique({});
+		// Only the frame submitted MAX_FRAMES_IN_FLIGHT frames ago is waited for
+		WaitFrame();
 
-		uint32_t imageIndex = m_screenContext.GetFrameIndex(*m_context.device, *imageAvailableSemaphore);
+		FrameStart(renderInfo.time);
 
 		uint32_t width = m_renderImages.GetWidth();
 		uint32_t height = m_renderImages.GetHeight();
 
-		UpdateDescriptorSet(m_renderImages);
+		UpdateDescriptorSet(m_renderImages, m_frameIndex);
 
-		m_commandBuffer->begin(vk::CommandBufferBeginInfo{});
+		vk::CommandBuffer commandBuffer = *m_frames[m_frameIndex].commandBuffer;
+		commandBuffer.begin(vk::CommandBufferBeginInfo{});
 
-		RecordCommandBuffer(width, height);
-		CopyRenderToScreen(*m_commandBuffer, m_renderImages.GetPostProcessedImage().GetImage(), m_screenContext.GetFrameImage(imageIndex), width, height);
-		RenderImGuiCommand(*m_commandBuffer, m_screenContext.GetFrameBuffer(imageIndex), width, height);
+		RecordCommandBuffer(commandBuffer, width, height);
+
+		uint32_t imageIndex = AcquireFrame();
+		CopyRenderToScreen(commandBuffer, m_renderImages.GetPostProcessedImage().GetImage(), m_screenContext.GetFrameImage(imageIndex), width, height);
+		RenderImGuiCommand(commandBuffer, m_screenContext.GetFrameBuffer(imageIndex), width, height);
 
 		if (renderInfo.isScreenShot) {
-			m_renderImages.ReadBack(*m_commandBuffer, *m_context.device);
+			m_renderImages.ReadBack(commandBuffer, *m_context.device);
 		}
 
-		m_commandBuffer->end();
-
-		vk::PipelineStageFlags waitStage{ vk::PipelineStageFlagBits::eTopOfPipe };
-		vk::SubmitInfo submitInfo{};
-		submitInfo.setWaitDstStageMask(waitStage);
-		submitInfo.setCommandBuffers(*m_commandBuffer);
-		submitInfo.setWaitSemaphores(*imageAvailableSemaphore);
-		m_context.queue.submit(submitInfo);
+		commandBuffer.end();
 
-		m_context.queue.waitIdle();
-
-		vk::PresentInfoKHR presentInfo{};
-		presentInfo.setSwapchains(*m_screenContext.swapchain);
-		presentInfo.setImageIndices(imageIndex);
-		if (m_context.queue.presentKHR(presentInfo) != vk::Result::eSuccess) {
-			std::cerr << "Failed to present.\n";
-			std::abort();
-		}
+		SubmitFrame(imageIndex);
 
 		if (renderInfo.isScreenShot) {
+			// The read back buffer is written by the frame just submitted
+			WaitFrames();
+
 			std::string time = GethCurrentTimeString();
 			m_renderImages.WritePNG(renderInfo.filepath, renderInfo.filename + time, *m_context.device, *m_commandPool, m_context.queue);
 		}
@@ -231,6 +245,8 @@ namespace Skhole {
 
 		auto& fps = renderInfo.fps;
 
+		WaitFrames();
+
 		RenderImages offlineRenderImages;
 		offlineRenderImages.Initialize(width, height, *m_context.device, m_context.physicalDevice, *m_commandPool, m_context.queue);
 
@@ -253,7 +269,11 @@ namespace Skhole {
 			std::cout << "Buffer Update" << std::endl;
 			{
 				m_scene->SetTransformMatrix(time);
-				m_sceneBufferManager.FrameUpdateInstance(time, *m_context.device, *m_commandPool, m_context.queue);
+				m_sceneBufferManager.FrameUpdateInstance(time, *m_context.device);
+				auto updatedGeometries = m_sceneBufferManager.FrameUpdateGeometry(*m_context.device, m_uploadManager);
+				m_uploadManager.Flush(*m_context.device);
+				m_skinningPass.Execute(time, m_sceneBufferManager, *m_context.device, *m_commandPool, m_context.queue, updatedGeometries);
+				m_asManager.UpdateBLAS(m_sceneBufferManager, updatedGeometries, *m_context.device, *m_commandPool, m_context.queue);
 				m_asManager.BuildTLAS(m_sceneBufferManager, m_context.physicalDevice, *m_context.device, *m_commandPool, m_context.queue);
 
 				auto& raytracerParam = m_scene->m_rendererParameter;
@@ -284,7 +304,7 @@ namespace Skhole {
 
 			}
 
-			UpdateDescriptorSet(offlineRenderImages);
+			UpdateDescriptorSet(offlineRenderImages, 0);
 
 			m_commandBuffer->begin(vk::CommandBufferBeginInfo{});
 			RaytracingCommand(*m_commandBuffer, width, height);
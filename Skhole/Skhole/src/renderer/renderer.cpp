@@ -17,6 +17,9 @@ namespace Skhole {
 		m_commandPool = vkutils::createCommandPool(*m_context.device, m_context.queueIndex);
 		m_commandBuffer = vkutils::createCommandBuffer(*m_context.device, *m_commandPool);
 
+		// The device has a single queue, uploads share it with rendering
+		m_uploadManager.Init(m_context.physicalDevice, *m_context.device, m_context.queueIndex, m_context.queue);
+
 
 		m_renderImages.Initialize(desc.Width, desc.Height, *m_context.device, m_context.physicalDevice, *m_commandPool, m_context.queue);
 
@@ -44,6 +47,8 @@ namespace Skhole {
 			swapchainInfo.height = desc.Height;
 
 			m_screenContext.Init(swapchainInfo);
+
+			InitFrameResources();
 		}
 
 		InitializeBiniding();
@@ -91,6 +96,7 @@ namespace Skhole {
 		ppDesc.commandPool = *m_commandPool;
 		ppDesc.width = desc.Width;
 		ppDesc.height = desc.Height;
+		ppDesc.numFrame = MAX_FRAMES_IN_FLIGHT;
 		m_postProcessor->Init(ppDesc);
 
 		InitializeCore(desc);
@@ -99,6 +105,8 @@ namespace Skhole {
 
 	void Renderer::Resize(unsigned int width, unsigned int height)
 	{
+		WaitFrames();
+
 		m_screenContext.Release(*m_context.device);
 
 		VkHelper::SwapChainInfo swapchainInfo{};
@@ -114,6 +122,8 @@ namespace Skhole {
 		swapchainInfo.height = height;
 		m_screenContext.Init(swapchainInfo);
 
+		InitFrameResources();
+
 		m_renderImages.Resize(width, height, *m_context.device, m_context.physicalDevice, *m_commandPool, m_context.queue);
 
 		m_postProcessor->Resize(width, height);
@@ -128,16 +138,108 @@ namespace Skhole {
 		m_context.device->waitIdle();
 
 		DestroyCore();
+		m_uploadManager.Release(*m_context.device);
 
 		m_bindingManager.Release(*m_context.device);
 		m_postProcessor->Destroy(*m_context.device);
 		m_postProcessor = nullptr;
 		m_renderImages.Release(*m_context.device);
 
+		ReleaseFrameResources();
 		m_screenContext.Release(*m_context.device);
 		if (editorMode) {
 			m_imGuiManager.Destroy(*m_context.device);
 		}
+
+		GetMemoryAllocator().Release(*m_context.device);
+	}
+
+	void Renderer::InitFrameResources()
+	{
+		ReleaseFrameResources();
+
+		for (auto& frame : m_frames) {
+			frame.commandBuffer = vkutils::createCommandBuffer(*m_context.device, *m_commandPool);
+			frame.fence = m_context.device->createFenceUnique({ vk::FenceCreateFlagBits::eSignaled });
+			frame.imageAvailableSemaphore = m_context.device->createSemaphoreUnique({});
+		}
+
+		for (size_t i = 0; i < m_screenContext.swapchainImages.size(); i++) {
+			m_renderFinishedSemaphores.push_back(m_context.device->createSemaphoreUnique({}));
+		}
+
+		m_frameIndex = 0;
+	}
+
+	void Renderer::ReleaseFrameResources()
+	{
+		for (auto& frame : m_frames) {
+			frame.commandBuffer.reset();
+			frame.fence.reset();
+			frame.imageAvailableSemaphore.reset();
+		}
+		m_renderFinishedSemaphores.clear();
+	}
+
+	// Waits until the previous use of m_frames[m_frameIndex] is finished
+	void Renderer::WaitFrame()
+	{
+		auto& fence = m_frames[m_frameIndex].fence;
+		if (!fence) return;
+
+		if (m_context.device->waitForFences(*fence, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+			std::cerr << "Failed to wait fence.\n";
+			std::abort();
+		}
+	}
+
+	// Waits for every frame in flight, before writing resources they share (AS, vertex and material buffers)
+	void Renderer::WaitFrames()
+	{
+		std::vector<vk::Fence> fences;
+		for (auto& frame : m_frames) {
+			if (frame.fence) fences.push_back(*frame.fence);
+		}
+		if (fences.empty()) return;
+
+		if (m_context.device->waitForFences(fences, true, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+			std::cerr << "Failed to wait fence.\n";
+			std::abort();
+		}
+	}
+
+	uint32_t Renderer::AcquireFrame()
+	{
+		return m_screenContext.GetFrameIndex(*m_context.device, *m_frames[m_frameIndex].imageAvailableSemaphore);
+	}
+
+	// Submits m_frames[m_frameIndex].commandBuffer and presents without waiting for the GPU
+	void Renderer::SubmitFrame(uint32_t imageIndex)
+	{
+		auto& frame = m_frames[m_frameIndex];
+		vk::Semaphore renderFinishedSemaphore = *m_renderFinishedSemaphores[imageIndex];
+
+		// The swapchain image is first written by the copy in CopyRenderToScreen, tracing starts before it is acquired
+		vk::PipelineStageFlags waitStage{ vk::PipelineStageFlagBits::eTransfer };
+		vk::SubmitInfo submitInfo{};
+		submitInfo.setWaitDstStageMask(waitStage);
+		submitInfo.setCommandBuffers(*frame.commandBuffer);
+		submitInfo.setWaitSemaphores(*frame.imageAvailableSemaphore);
+		submitInfo.setSignalSemaphores(renderFinishedSemaphore);
+
+		m_context.device->resetFences(*frame.fence);
+		m_context.queue.submit(submitInfo, *frame.fence);
+
+		vk::PresentInfoKHR presentInfo{};
+		presentInfo.setWaitSemaphores(renderFinishedSemaphore);
+		presentInfo.setSwapchains(*m_screenContext.swapchain);
+		presentInfo.setImageIndices(imageIndex);
+		if (m_context.queue.presentKHR(presentInfo) != vk::Result::eSuccess) {
+			std::cerr << "Failed to present.\n";
+			std::abort();
+		}
+
+		m_frameIndex = (m_frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
 	void Renderer::RaytracingCommand(const vk::CommandBuffer& commandBuffer, uint32_t width, uint32_t height) {
@@ -147,10 +249,10 @@ namespace Skhole {
 			m_raytracingPipeline.GetPipelineLayout(),
 			0,
 			m_bindingManager.descriptorSet,
-			nullptr
+			m_dynamicOffsets
 		);
 
-		m_commandBuffer->traceRaysKHR(
+		commandBuffer.traceRaysKHR(
 			m_raytracingPipeline.GetRaygenRegion(),
 			m_raytracingPipeline.GetMissRegion(),
 			m_raytracingPipeline.GetHitRegion(),
@@ -159,9 +261,18 @@ namespace Skhole {
 		);
 	}
 
-	void Renderer::RecordCommandBuffer(uint32_t width, uint32_t height) {
+	void Renderer::RecordCommandBuffer(const vk::CommandBuffer& commandBuffer, uint32_t width, uint32_t height) {
+
+		// The previous frame may still be writing the render and accumulation images
+		vk::MemoryBarrier barrier{};
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+		barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eAllCommands,
+			vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader,
+			{}, barrier, {}, {});
 
-		RaytracingCommand(*m_commandBuffer, width, height);
+		RaytracingCommand(commandBuffer, width, height);
 
 		// Post Process
 		PostProcessor::ExecuteDesc desc{};
@@ -169,13 +280,14 @@ namespace Skhole {
 		desc.inputImage = m_renderImages.GetRenderImage().GetImageView();
 		desc.outputImage = m_renderImages.GetPostProcessedImage().GetImageView();
 		desc.param = m_scene->m_rendererParameter->posproParameters;
+		desc.frameIndex = m_frameIndex;
 
-		m_postProcessor->Execute(*m_commandBuffer, desc);
+		m_postProcessor->Execute(commandBuffer, desc);
 	}
 
 	void Renderer::CopyRenderToScreen(const vk::CommandBuffer& commandBuffer, vk::Image src, vk::Image screen, uint32_t width, uint32_t height) {
-		vkutils::setImageLayout(*m_commandBuffer, src, vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal);
-		vkutils::setImageLayout(*m_commandBuffer, screen, vk::ImageLayout::ePresentSrcKHR, vk::ImageLayout::eTransferDstOptimal);
+		vkutils::setImageLayout(commandBuffer, src, vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal);
+		vkutils::setImageLayout(commandBuffer, screen, vk::ImageLayout::ePresentSrcKHR, vk::ImageLayout::eTransferDstOptimal);
 
 		vk::ImageCopy region;
 		region.srcSubresource = vk::ImageSubresourceLayers()
@@ -195,14 +307,14 @@ namespace Skhole {
 
 		region.extent = vk::Extent3D(width, height, 1);
 
-		m_commandBuffer->copyImage(
+		commandBuffer.copyImage(
 			src, vk::ImageLayout::eTransferSrcOptimal,
 			screen, vk::ImageLayout::eTransferDstOptimal,
 			region
 		);
 
-		vkutils::setImageLayout(*m_commandBuffer, src, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eGeneral);
-		vkutils::setImageLayout(*m_commandBuffer, screen, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eAttachmentOptimal);
+		vkutils::setImageLayout(commandBuffer, src, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eGeneral);
+		vkutils::setImageLayout(commandBuffer, screen, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eAttachmentOptimal);
 	}
 
 	void Renderer::RenderImGuiCommand(const vk::CommandBuffer& commandBuffer, vk::Framebuffer frameBuffer, uint32_t width, uint32_t height) {
@@ -213,12 +325,12 @@ namespace Skhole {
 
 		renderPassInfo.setRenderArea(rect);
 
-		m_commandBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+		commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
 
 		ImGui::Render();
-		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *m_commandBuffer);
+		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
 
-		m_commandBuffer->endRenderPass();
+		commandBuffer.endRenderPass();
 	}
 
 	ShrPtr<RendererDefinisionMaterial> Renderer::GetMaterial(const ShrPtr<BasicMaterial>& material) {